@@ -2,7 +2,10 @@
 
 #include "exla_nif_util.h"
 #include "exla_client.h"
+#include "exla_infeed.h"
 #include "exla_log_sink.h"
+#include "exla_outfeed.h"
+#include "exla_tape.h"
 #include "tensorflow/compiler/xla/service/platform_util.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
@@ -14,6 +17,8 @@
 #include "tensorflow/compiler/xla/client/lib/self_adjoint_eig.h"
 #include "tensorflow/compiler/xla/client/lib/svd.h"
 #include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
 
 // All of these are created with calls to `new` and subsequently
 // passed to the VM as pointers-to-pointers so we balance it out
@@ -51,6 +56,21 @@ void free_exla_buffer(ErlNifEnv* env, void * obj) {
   }
 }
 
+void free_exla_outfeed_reader(ErlNifEnv* env, void * obj) {
+  exla::ExlaOutfeedReaderRef* reader = reinterpret_cast<exla::ExlaOutfeedReaderRef*>(obj);
+  // The reader threads hold their own reference and keep draining
+  // the outfeed until the computation is done
+  (*reader)->Close();
+  reader->~ExlaOutfeedReaderRef();
+}
+
+void free_exla_infeed_queue(ErlNifEnv* env, void * obj) {
+  exla::ExlaInfeedQueueRef* queue = reinterpret_cast<exla::ExlaInfeedQueueRef*>(obj);
+  // Entries already queued are still transferred by the feeder thread
+  (*queue)->Close();
+  queue->~ExlaInfeedQueueRef();
+}
+
 static int open_resources(ErlNifEnv* env) {
   const char* mod = "EXLA";
 
@@ -75,6 +95,15 @@ static int open_resources(ErlNifEnv* env) {
   if (!exla::nif::open_resource<exla::ExlaBuffer*>(env, mod, "ExlaBuffer", free_exla_buffer)) {
     return -1;
   }
+  if (!exla::nif::open_resource<exla::ExlaExternalReference>(env, mod, "ExlaExternalReference")) {
+    return -1;
+  }
+  if (!exla::nif::open_resource<exla::ExlaInfeedQueueRef>(env, mod, "ExlaInfeedQueue", free_exla_infeed_queue)) {
+    return -1;
+  }
+  if (!exla::nif::open_resource<exla::ExlaOutfeedReaderRef>(env, mod, "ExlaOutfeedReader", free_exla_outfeed_reader)) {
+    return -1;
+  }
   return 1;
 }
 
@@ -122,7 +151,7 @@ ERL_NIF_TERM create_sub_builder(ErlNifEnv* env, int argc, const ERL_NIF_TERM arg
 }
 
 ERL_NIF_TERM build(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
-  if (argc != 2) {
+  if (argc != 3) {
     return exla::nif::error(env, "Bad argument count.");
   }
 
@@ -136,6 +165,24 @@ ERL_NIF_TERM build(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
     return exla::nif::error(env, "Bad argument passed to build.");
   }
 
+  // Aliases are {output_index, parameter_number} pairs, which allow
+  // XLA to write the output into the (donated) parameter memory
+  ERL_NIF_TERM head, tail, aliases = argv[2];
+  while (enif_get_list_cell(env, aliases, &head, &tail)) {
+    const ERL_NIF_TERM* tuple;
+    int arity;
+    exla::int64 output_index, param_number;
+
+    if (!enif_get_tuple(env, head, &arity, &tuple) || arity != 2 ||
+        !exla::nif::get(env, tuple[0], &output_index) ||
+        !exla::nif::get(env, tuple[1], &param_number)) {
+      return exla::nif::error(env, "Unable to get input/output alias.");
+    }
+
+    (*builder)->SetUpAlias({output_index}, param_number, {});
+    aliases = tail;
+  }
+
   EXLA_ASSIGN_OR_RETURN_NIF(xla::XlaComputation computation,
     (*builder)->Build(*root), env);
 
@@ -143,7 +190,7 @@ ERL_NIF_TERM build(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
 }
 
 ERL_NIF_TERM parameter(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
-  if (argc != 4) {
+  if (argc != 5) {
     return exla::nif::error(env, "Bad argument count.");
   }
 
@@ -165,49 +212,116 @@ ERL_NIF_TERM parameter(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
     return exla::nif::error(env, "Unable to get parameter name.");
   }
 
+  // Parameters are optionally sharded, which sets how the parameter
+  // is split across partitions when compiled with SPMD partitioning
+  absl::optional<xla::OpSharding> sharding;
+  std::string atom;
+  if (!exla::nif::get_atom(env, argv[4], &atom) || atom != "nil") {
+    xla::OpSharding op_sharding;
+    if (!exla::nif::get_op_sharding(env, argv[4], &op_sharding)) {
+      return exla::nif::error(env, "Unable to get parameter sharding.");
+    }
+    sharding = op_sharding;
+  }
+
+  xla::XlaScopedShardingAssignment assign_sharding(*builder, sharding);
   xla::XlaOp op = xla::Parameter((*builder), param_num, *shape, name);
 
   return exla::nif::ok(env, exla::nif::make<xla::XlaOp>(env, op));
 }
 
+ERL_NIF_TERM sharding(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 2) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  xla::XlaOp* operand;
+  xla::OpSharding op_sharding;
+
+  if (!exla::nif::get<xla::XlaOp>(env, argv[0], operand)) {
+    return exla::nif::error(env, "Unable to get operand.");
+  }
+  if (!exla::nif::get_op_sharding(env, argv[1], &op_sharding)) {
+    return exla::nif::error(env, "Unable to get sharding.");
+  }
+
+  xla::XlaBuilder* builder = operand->builder();
+  EXLA_ASSIGN_OR_RETURN_NIF(xla::Shape shape, builder->GetShape(*operand), env);
+
+  // XLA has no instruction to annotate an existing op, so we pass the
+  // operand through a "Sharding" custom call, which the SPMD partitioner
+  // understands as a sharding constraint and removes afterwards
+  xla::XlaScopedShardingAssignment assign_sharding(builder, op_sharding);
+  xla::XlaOp op = xla::CustomCall(builder, "Sharding", {*operand}, shape);
+
+  return exla::nif::ok(env, exla::nif::make<xla::XlaOp>(env, op));
+}
+
+ERL_NIF_TERM build_tape(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 3) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  xla::XlaBuilder** builder;
+  std::vector<xla::XlaOp> parameters;
+  ErlNifBinary tape;
+
+  if (!exla::nif::get<xla::XlaBuilder*>(env, argv[0], builder)) {
+    return exla::nif::error(env, "Unable to get builder.");
+  }
+  if (!exla::nif::get_list<xla::XlaOp>(env, argv[1], parameters)) {
+    return exla::nif::error(env, "Unable to get parameters.");
+  }
+  if (!exla::nif::get_binary(env, argv[2], &tape)) {
+    return exla::nif::error(env, "Unable to get tape.");
+  }
+
+  EXLA_ASSIGN_OR_RETURN_NIF(xla::XlaOp op,
+    exla::BuildTape(*builder, parameters, tape.data, tape.size), env);
+
+  return exla::nif::ok(env, exla::nif::make<xla::XlaOp>(env, op));
+}
+
 // ExlaBuffer Functions
 
-ERL_NIF_TERM binary_to_device_mem(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
-  if (argc != 4) {
+ERL_NIF_TERM binaries_to_device_mem(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 3) {
     return exla::nif::error(env, "Bad argument count.");
   }
 
-  ErlNifBinary bin;
-  xla::Shape* shape;
   exla::ExlaClient** client;
   int device_id;
 
   if (!exla::nif::get<exla::ExlaClient*>(env, argv[0], client)) {
     return exla::nif::error(env, "Unable to get client.");
   }
-  if (!exla::nif::get_binary(env, argv[1], &bin)) {
-    return exla::nif::error(env, "Unable to get data.");
-  }
-  if (!exla::nif::get<xla::Shape>(env, argv[2], shape)) {
-    return exla::nif::error(env, "Unable to get shape.");
+  if (!enif_is_list(env, argv[1])) {
+    return exla::nif::error(env, "Unable to get data and shapes.");
   }
-  if (!exla::nif::get(env, argv[3], &device_id)) {
+  if (!exla::nif::get(env, argv[2], &device_id)) {
     return exla::nif::error(env, "Unable to get device ordinal.");
   }
 
-  EXLA_ASSIGN_OR_RETURN_NIF(exla::ExlaBuffer* buffer,
-    (*client)->BufferFromBinary(bin, *shape, device_id, false), env);
-  EXLA_EFFECT_OR_RETURN_NIF(buffer->BlockHostUntilReady(), env);
-  return exla::nif::ok(env, exla::nif::make<exla::ExlaBuffer*>(env, buffer));
+  EXLA_ASSIGN_OR_RETURN_NIF(std::vector<exla::ExlaBuffer*> buffers,
+    (*client)->BuffersFromBinaries(env, argv[1], device_id), env);
+
+  std::vector<ERL_NIF_TERM> terms;
+  terms.reserve(buffers.size());
+  for (auto buffer : buffers) {
+    terms.push_back(exla::nif::make<exla::ExlaBuffer*>(env, buffer));
+  }
+
+  return exla::nif::ok(env, enif_make_list_from_array(env, terms.data(), terms.size()));
 }
 
 ERL_NIF_TERM read_device_mem(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
-  if (argc != 3) {
+  if (argc != 4) {
     return exla::nif::error(env, "Bad argument count.");
   }
 
   exla::ExlaClient** client;
   exla::ExlaBuffer** buffer;
+  exla::int64 offset;
   exla::int64 size;
 
   if (!exla::nif::get<exla::ExlaClient*>(env, argv[0], client)) {
@@ -216,11 +330,14 @@ ERL_NIF_TERM read_device_mem(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]
   if (!exla::nif::get<exla::ExlaBuffer*>(env, argv[1], buffer)) {
     return exla::nif::error(env, "Unable to get buffer.");
   }
-  if (!exla::nif::get(env, argv[2], &size)) {
+  if (!exla::nif::get(env, argv[2], &offset)) {
+    return exla::nif::error(env, "Unable to get offset.");
+  }
+  if (!exla::nif::get(env, argv[3], &size)) {
     return exla::nif::error(env, "Unable to get size.");
   }
 
-  EXLA_ASSIGN_OR_RETURN_NIF(ERL_NIF_TERM binary, (*buffer)->ToBinary(env, size), env);
+  EXLA_ASSIGN_OR_RETURN_NIF(ERL_NIF_TERM binary, (*buffer)->ToBinary(env, offset, size), env);
 
   return exla::nif::ok(env, binary);
 }
@@ -1702,6 +1819,196 @@ ERL_NIF_TERM variadic_sort(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
   return exla::nif::ok(env, exla::nif::make<xla::XlaOp>(env, op));
 }
 
+// Collective Ops
+
+ERL_NIF_TERM replica_id(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 1) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  xla::XlaBuilder** builder;
+
+  if (!exla::nif::get<xla::XlaBuilder*>(env, argv[0], builder)) {
+    return exla::nif::error(env, "Unable to get builder.");
+  }
+
+  xla::XlaOp op = xla::ReplicaId(*builder);
+
+  return exla::nif::ok(env, exla::nif::make<xla::XlaOp>(env, op));
+}
+
+ERL_NIF_TERM all_reduce(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 3) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  xla::XlaOp* operand;
+  xla::XlaComputation* computation;
+  std::vector<xla::ReplicaGroup> replica_groups;
+
+  if (!exla::nif::get<xla::XlaOp>(env, argv[0], operand)) {
+    return exla::nif::error(env, "Unable to get operand.");
+  }
+  if (!exla::nif::get<xla::XlaComputation>(env, argv[1], computation)) {
+    return exla::nif::error(env, "Unable to get computation.");
+  }
+  if (!exla::nif::get_replica_groups(env, argv[2], replica_groups)) {
+    return exla::nif::error(env, "Unable to get replica groups.");
+  }
+
+  xla::XlaOp op = xla::AllReduce(*operand, *computation, replica_groups);
+
+  return exla::nif::ok(env, exla::nif::make<xla::XlaOp>(env, op));
+}
+
+ERL_NIF_TERM all_gather(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 4) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  xla::XlaOp* operand;
+  exla::int64 all_gather_dimension;
+  exla::int64 shard_count;
+  std::vector<xla::ReplicaGroup> replica_groups;
+
+  if (!exla::nif::get<xla::XlaOp>(env, argv[0], operand)) {
+    return exla::nif::error(env, "Unable to get operand.");
+  }
+  if (!exla::nif::get(env, argv[1], &all_gather_dimension)) {
+    return exla::nif::error(env, "Unable to get all gather dimension.");
+  }
+  if (!exla::nif::get(env, argv[2], &shard_count)) {
+    return exla::nif::error(env, "Unable to get shard count.");
+  }
+  if (!exla::nif::get_replica_groups(env, argv[3], replica_groups)) {
+    return exla::nif::error(env, "Unable to get replica groups.");
+  }
+
+  xla::XlaOp op = xla::AllGather(*operand, all_gather_dimension, shard_count, replica_groups);
+
+  return exla::nif::ok(env, exla::nif::make<xla::XlaOp>(env, op));
+}
+
+ERL_NIF_TERM reduce_scatter(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 5) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  xla::XlaOp* operand;
+  xla::XlaComputation* computation;
+  exla::int64 scatter_dimension;
+  exla::int64 shard_count;
+  std::vector<xla::ReplicaGroup> replica_groups;
+
+  if (!exla::nif::get<xla::XlaOp>(env, argv[0], operand)) {
+    return exla::nif::error(env, "Unable to get operand.");
+  }
+  if (!exla::nif::get<xla::XlaComputation>(env, argv[1], computation)) {
+    return exla::nif::error(env, "Unable to get computation.");
+  }
+  if (!exla::nif::get(env, argv[2], &scatter_dimension)) {
+    return exla::nif::error(env, "Unable to get scatter dimension.");
+  }
+  if (!exla::nif::get(env, argv[3], &shard_count)) {
+    return exla::nif::error(env, "Unable to get shard count.");
+  }
+  if (!exla::nif::get_replica_groups(env, argv[4], replica_groups)) {
+    return exla::nif::error(env, "Unable to get replica groups.");
+  }
+
+  xla::XlaBuilder* builder = operand->builder();
+  EXLA_ASSIGN_OR_RETURN_NIF(xla::Shape shape, builder->GetShape(*operand), env);
+
+  if (scatter_dimension < 0 || scatter_dimension >= shape.rank() || shard_count <= 0 ||
+      shape.dimensions(scatter_dimension) % shard_count != 0) {
+    return exla::nif::error(env, "Scatter dimension must be divisible by the shard count.");
+  }
+
+  // The XLA version we build against has no native reduce scatter,
+  // so we all-reduce and each replica keeps the shard at its position
+  // within its replica group.
+  xla::XlaOp reduced = xla::AllReduce(*operand, *computation, replica_groups);
+  xla::XlaOp position = xla::ReplicaId(builder);
+
+  if (!replica_groups.empty()) {
+    std::vector<xla::uint32> positions;
+
+    for (const auto& group : replica_groups) {
+      for (int i = 0; i < group.replica_ids_size(); i++) {
+        exla::int64 id = group.replica_ids(i);
+        if (id >= static_cast<exla::int64>(positions.size())) positions.resize(id + 1, 0);
+        positions[id] = i;
+      }
+    }
+
+    xla::XlaOp table = xla::ConstantR1<xla::uint32>(builder, positions);
+    position = xla::Reshape(xla::DynamicSlice(table, {position}, {1}), std::vector<exla::int64>{});
+  }
+
+  exla::int64 shard_size = shape.dimensions(scatter_dimension) / shard_count;
+  std::vector<xla::XlaOp> start_indices(shape.rank(), xla::ConstantR0<xla::uint32>(builder, 0));
+  start_indices[scatter_dimension] = xla::Mul(position, xla::ConstantR0<xla::uint32>(builder, shard_size));
+
+  std::vector<exla::int64> slice_sizes(shape.dimensions().begin(), shape.dimensions().end());
+  slice_sizes[scatter_dimension] = shard_size;
+
+  xla::XlaOp op = xla::DynamicSlice(reduced, start_indices, slice_sizes);
+
+  return exla::nif::ok(env, exla::nif::make<xla::XlaOp>(env, op));
+}
+
+ERL_NIF_TERM all_to_all(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 5) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  xla::XlaOp* operand;
+  exla::int64 split_dimension;
+  exla::int64 concat_dimension;
+  exla::int64 split_count;
+  std::vector<xla::ReplicaGroup> replica_groups;
+
+  if (!exla::nif::get<xla::XlaOp>(env, argv[0], operand)) {
+    return exla::nif::error(env, "Unable to get operand.");
+  }
+  if (!exla::nif::get(env, argv[1], &split_dimension)) {
+    return exla::nif::error(env, "Unable to get split dimension.");
+  }
+  if (!exla::nif::get(env, argv[2], &concat_dimension)) {
+    return exla::nif::error(env, "Unable to get concat dimension.");
+  }
+  if (!exla::nif::get(env, argv[3], &split_count)) {
+    return exla::nif::error(env, "Unable to get split count.");
+  }
+  if (!exla::nif::get_replica_groups(env, argv[4], replica_groups)) {
+    return exla::nif::error(env, "Unable to get replica groups.");
+  }
+
+  xla::XlaOp op = xla::AllToAll(*operand, split_dimension, concat_dimension, split_count, replica_groups);
+
+  return exla::nif::ok(env, exla::nif::make<xla::XlaOp>(env, op));
+}
+
+ERL_NIF_TERM collective_permute(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 2) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  xla::XlaOp* operand;
+  std::vector<std::pair<exla::int64, exla::int64>> source_target_pairs;
+
+  if (!exla::nif::get<xla::XlaOp>(env, argv[0], operand)) {
+    return exla::nif::error(env, "Unable to get operand.");
+  }
+  if (!exla::nif::get_source_target_pairs(env, argv[1], source_target_pairs)) {
+    return exla::nif::error(env, "Unable to get source/target pairs.");
+  }
+
+  xla::XlaOp op = xla::CollectivePermute(*operand, source_target_pairs);
+
+  return exla::nif::ok(env, exla::nif::make<xla::XlaOp>(env, op));
+}
+
 // LinAlg Functions
 
 ERL_NIF_TERM cholesky(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
@@ -1994,6 +2301,54 @@ ERL_NIF_TERM transfer_to_infeed(ErlNifEnv* env, int argc, const ERL_NIF_TERM arg
   return exla::nif::ok(env);
 }
 
+ERL_NIF_TERM start_infeed_queue(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 3) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  exla::ExlaClient** client;
+  int device_id;
+  int depth;
+
+  if (!exla::nif::get<exla::ExlaClient*>(env, argv[0], client)) {
+    return exla::nif::error(env, "Unable to get client.");
+  }
+  if (!exla::nif::get(env, argv[1], &device_id)) {
+    return exla::nif::error(env, "Unable to get device ID.");
+  }
+  if (!exla::nif::get(env, argv[2], &depth) || depth < 1) {
+    return exla::nif::error(env, "Unable to get depth.");
+  }
+
+  EXLA_ASSIGN_OR_RETURN_NIF(xla::PjRtDevice* device,
+    (*client)->client()->LookupDevice(device_id), env);
+
+  auto queue = std::make_shared<exla::ExlaInfeedQueue>(device, depth);
+  queue->Start();
+
+  return exla::nif::ok(env, exla::nif::make<exla::ExlaInfeedQueueRef>(env, queue));
+}
+
+ERL_NIF_TERM infeed_queue_push(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 2) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  exla::ExlaInfeedQueueRef* queue;
+
+  if (!exla::nif::get<exla::ExlaInfeedQueueRef>(env, argv[0], queue)) {
+    return exla::nif::error(env, "Unable to get infeed queue.");
+  }
+
+  xla::Status status = (*queue)->Push(env, argv[1]);
+
+  if (!status.ok()) {
+    return exla::nif::error(env, status.error_message().c_str());
+  }
+
+  return exla::nif::ok(env);
+}
+
 ERL_NIF_TERM transfer_from_outfeed(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
   if (argc != 5) {
     return exla::nif::error(env, "Bad argument count.");
@@ -2043,8 +2398,129 @@ ERL_NIF_TERM transfer_from_outfeed(ErlNifEnv* env, int argc, const ERL_NIF_TERM
   return exla::nif::ok(env);
 }
 
+ERL_NIF_TERM start_outfeed_reader(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 7) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  exla::ExlaClient** client;
+  int device_id;
+  ErlNifPid pid;
+  int capacity;
+  int max_batch;
+
+  if (!exla::nif::get<exla::ExlaClient*>(env, argv[0], client)) {
+    return exla::nif::error(env, "Unable to get client.");
+  }
+  if (!exla::nif::get(env, argv[1], &device_id)) {
+    return exla::nif::error(env, "Unable to get device ID.");
+  }
+  if (!enif_get_local_pid(env, argv[3], &pid)) {
+    return exla::nif::error(env, "Unable to get pid.");
+  }
+  if (!exla::nif::get(env, argv[5], &capacity) || capacity < 1) {
+    return exla::nif::error(env, "Unable to get capacity.");
+  }
+  if (!exla::nif::get(env, argv[6], &max_batch) || max_batch < 1) {
+    return exla::nif::error(env, "Unable to get max batch.");
+  }
+
+  std::map<uint16, std::vector<xla::Shape>> hooks;
+  ERL_NIF_TERM list = argv[2];
+  ERL_NIF_TERM head, tail;
+  while (enif_get_list_cell(env, list, &head, &tail)) {
+    const ERL_NIF_TERM* terms;
+    int count;
+    uint16 flag;
+    std::vector<xla::Shape> shapes;
+
+    if (!enif_get_tuple(env, head, &count, &terms) || count != 2 ||
+        !exla::nif::get(env, terms[0], &flag) || flag == 0) {
+      return exla::nif::error(env, "Unable to get outfeed flag.");
+    }
+
+    ERL_NIF_TERM shape_list = terms[1];
+    ERL_NIF_TERM shape_head, shape_tail;
+    while (enif_get_list_cell(env, shape_list, &shape_head, &shape_tail)) {
+      xla::Shape* shape;
+      if (!exla::nif::get<xla::Shape>(env, shape_head, shape)) {
+        return exla::nif::error(env, "Unable to get shape.");
+      }
+      shapes.push_back(*shape);
+      shape_list = shape_tail;
+    }
+
+    hooks[flag] = std::move(shapes);
+    list = tail;
+  }
+
+  EXLA_ASSIGN_OR_RETURN_NIF(xla::PjRtDevice* device,
+    (*client)->client()->LookupDevice(device_id), env);
+
+  auto reader = std::make_shared<exla::ExlaOutfeedReader>(device, std::move(hooks), pid, argv[4], capacity, max_batch);
+  reader->Start();
+
+  return exla::nif::ok(env, exla::nif::make<exla::ExlaOutfeedReaderRef>(env, reader));
+}
+
+ERL_NIF_TERM outfeed_reader_ack(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 1) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  exla::ExlaOutfeedReaderRef* reader;
+
+  if (!exla::nif::get<exla::ExlaOutfeedReaderRef>(env, argv[0], reader)) {
+    return exla::nif::error(env, "Unable to get outfeed reader.");
+  }
+
+  (*reader)->Ack();
+
+  return exla::nif::ok(env);
+}
+
 // ExlaClient Functions
 
+ERL_NIF_TERM set_memory_budget(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 2) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  exla::ExlaClient** client;
+  exla::int64 bytes;
+
+  if (!exla::nif::get<exla::ExlaClient*>(env, argv[0], client)) {
+    return exla::nif::error(env, "Unable to get client.");
+  }
+  if (!exla::nif::get(env, argv[1], &bytes)) {
+    return exla::nif::error(env, "Unable to get memory budget.");
+  }
+
+  (*client)->SetMemoryBudget(bytes);
+
+  return exla::nif::ok(env);
+}
+
+ERL_NIF_TERM get_memory_stats(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 2) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  exla::ExlaClient** client;
+  int device_id;
+
+  if (!exla::nif::get<exla::ExlaClient*>(env, argv[0], client)) {
+    return exla::nif::error(env, "Unable to get client.");
+  }
+  if (!exla::nif::get(env, argv[1], &device_id)) {
+    return exla::nif::error(env, "Unable to get device ID.");
+  }
+
+  EXLA_ASSIGN_OR_RETURN_NIF(ERL_NIF_TERM stats, (*client)->MemoryStats(env, device_id), env);
+
+  return exla::nif::ok(env, stats);
+}
+
 ERL_NIF_TERM get_host_client(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
   if (argc != 0) {
     return exla::nif::error(env, "Bad argument count.");
@@ -2123,7 +2599,7 @@ ERL_NIF_TERM get_supported_platforms(ErlNifEnv* env, int argc, const ERL_NIF_TER
   return exla::nif::ok(env, exla::nif::make_map(env, platform_info));
 }
 
-ERL_NIF_TERM compile(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+ERL_NIF_TERM compile_async(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
   if (argc != 7) {
     return exla::nif::error(env, "Bad argument count.");
   }
@@ -2136,6 +2612,7 @@ ERL_NIF_TERM compile(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
   int num_partitions;
   bool use_spmd;
   int device_id;
+  ErlNifPid pid;
 
   if (!exla::nif::get<exla::ExlaClient*>(env, argv[0], client)) {
     return exla::nif::error(env, "Unable to get client.");
@@ -2158,6 +2635,247 @@ ERL_NIF_TERM compile(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
   if (!exla::nif::get(env, argv[6], &device_id)) {
     return exla::nif::error(env, "Unable to get device ID.");
   }
+  if (!enif_self(env, &pid)) {
+    return exla::nif::error(env, "Unable to get caller pid.");
+  }
+
+  build_options.set_num_replicas(num_replicas);
+  build_options.set_num_partitions(num_partitions);
+  build_options.set_use_spmd_partitioning(use_spmd);
+
+  bool compile_portable_executable = false;
+  if (device_id >= 0) {
+    compile_portable_executable = true;
+    build_options.set_device_ordinal(device_id);
+  }
+
+  // The computation and shapes are copied, as their resources
+  // may be garbage collected before compilation finishes
+  std::vector<xla::Shape> layouts;
+  layouts.reserve(argument_layouts.size());
+  for (auto shape : argument_layouts) {
+    layouts.push_back(*shape);
+  }
+
+  ErlNifEnv* msg_env = enif_alloc_env();
+  ERL_NIF_TERM ref = enif_make_ref(env);
+  ERL_NIF_TERM msg_ref = enif_make_copy(msg_env, ref);
+
+  (*client)->CompileAsync(pid,
+                          msg_env,
+                          msg_ref,
+                          xla::XlaComputation(computation->proto()),
+                          std::move(layouts),
+                          build_options,
+                          compile_portable_executable);
+
+  return exla::nif::ok(env, ref);
+}
+
+ERL_NIF_TERM serialize_computation(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 1) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  xla::XlaComputation* computation;
+
+  if (!exla::nif::get<xla::XlaComputation>(env, argv[0], computation)) {
+    return exla::nif::error(env, "Unable to get computation.");
+  }
+
+  std::string serialized;
+  if (!computation->proto().SerializeToString(&serialized)) {
+    return exla::nif::error(env, "Unable to serialize computation.");
+  }
+
+  ErlNifBinary binary;
+  enif_alloc_binary(serialized.size(), &binary);
+  std::memcpy(binary.data, serialized.data(), serialized.size());
+
+  return exla::nif::ok(env, exla::nif::make(env, binary));
+}
+
+// Imports a computation from a serialized HloModuleProto
+ERL_NIF_TERM computation_from_hlo_proto(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 1) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  ErlNifBinary binary;
+
+  if (!exla::nif::get_binary(env, argv[0], &binary)) {
+    return exla::nif::error(env, "Unable to get HLO module proto.");
+  }
+
+  xla::HloModuleProto proto;
+  if (!proto.ParseFromArray(binary.data, binary.size)) {
+    return exla::nif::error(env, "Unable to parse HLO module proto.");
+  }
+
+  if (!proto.has_host_program_shape()) {
+    return exla::nif::error(env, "HLO module proto has no program shape.");
+  }
+
+  // Make sure the module is well-formed before handing it to the VM
+  EXLA_ASSIGN_OR_RETURN_NIF(xla::ProgramShape program_shape,
+    xla::ProgramShape::FromProto(proto.host_program_shape()), env);
+
+  xla::HloModuleConfig config(program_shape);
+  EXLA_ASSIGN_OR_RETURN_NIF(std::unique_ptr<xla::HloModule> module,
+    xla::HloModule::CreateFromProto(proto, config), env);
+
+  return exla::nif::ok(env, exla::nif::make<xla::XlaComputation>(env, xla::XlaComputation(module->ToProto())));
+}
+
+// Imports a computation from HLO text, as printed by XLA
+ERL_NIF_TERM computation_from_hlo_text(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 1) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  std::string text;
+
+  if (!exla::nif::get(env, argv[0], text)) {
+    return exla::nif::error(env, "Unable to get HLO text.");
+  }
+
+  EXLA_ASSIGN_OR_RETURN_NIF(std::unique_ptr<xla::HloModule> module,
+    xla::ParseAndReturnUnverifiedModule(text), env);
+
+  return exla::nif::ok(env, exla::nif::make<xla::XlaComputation>(env, xla::XlaComputation(module->ToProto())));
+}
+
+// Returns the computation as HLO text. Canonical text names instructions
+// by their position instead of the ids given by the builder, so the same
+// computation prints the same text every time it is built.
+ERL_NIF_TERM computation_to_hlo_text(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 2) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  xla::XlaComputation* computation;
+  bool canonical;
+
+  if (!exla::nif::get<xla::XlaComputation>(env, argv[0], computation)) {
+    return exla::nif::error(env, "Unable to get computation.");
+  }
+  if (!exla::nif::get(env, argv[1], &canonical)) {
+    return exla::nif::error(env, "Unable to get canonical flag.");
+  }
+
+  EXLA_ASSIGN_OR_RETURN_NIF(xla::ProgramShape program_shape, computation->GetProgramShape(), env);
+  xla::HloModuleConfig config(program_shape);
+  EXLA_ASSIGN_OR_RETURN_NIF(std::unique_ptr<xla::HloModule> module,
+    xla::HloModule::CreateFromProto(computation->proto(), config), env);
+
+  std::string text = canonical ? module->ToString(xla::HloPrintOptions::Canonical()) : module->ToString();
+
+  ErlNifBinary binary;
+  enif_alloc_binary(text.size(), &binary);
+  std::memcpy(binary.data, text.data(), text.size());
+
+  return exla::nif::ok(env, exla::nif::make(env, binary));
+}
+
+// Returns the parameter shapes and the result shape of a computation
+ERL_NIF_TERM get_program_shape(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 1) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  xla::XlaComputation* computation;
+
+  if (!exla::nif::get<xla::XlaComputation>(env, argv[0], computation)) {
+    return exla::nif::error(env, "Unable to get computation.");
+  }
+
+  EXLA_ASSIGN_OR_RETURN_NIF(xla::ProgramShape program_shape, computation->GetProgramShape(), env);
+
+  std::vector<ERL_NIF_TERM> parameters;
+  for (const xla::Shape& shape : program_shape.parameters()) {
+    parameters.push_back(exla::nif::make<xla::Shape>(env, shape));
+  }
+
+  ERL_NIF_TERM parameters_term = enif_make_list_from_array(env, parameters.data(), parameters.size());
+  ERL_NIF_TERM result_term = exla::nif::make<xla::Shape>(env, program_shape.result());
+
+  return exla::nif::ok(env, enif_make_tuple2(env, parameters_term, result_term));
+}
+
+ERL_NIF_TERM get_executable_size(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 1) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  exla::ExlaExecutable** executable;
+
+  if (!exla::nif::get<exla::ExlaExecutable*>(env, argv[0], executable)) {
+    return exla::nif::error(env, "Unable to get executable.");
+  }
+
+  return exla::nif::ok(env, enif_make_int64(env, (*executable)->size_bytes()));
+}
+
+ERL_NIF_TERM serialize_executable(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 2) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  exla::ExlaClient** client;
+  exla::ExlaExecutable** executable;
+
+  if (!exla::nif::get<exla::ExlaClient*>(env, argv[0], client)) {
+    return exla::nif::error(env, "Unable to get client.");
+  }
+  if (!exla::nif::get<exla::ExlaExecutable*>(env, argv[1], executable)) {
+    return exla::nif::error(env, "Unable to get executable.");
+  }
+
+  EXLA_ASSIGN_OR_RETURN_NIF(std::string serialized,
+    (*client)->SerializeExecutable(*executable), env);
+
+  ErlNifBinary binary;
+  enif_alloc_binary(serialized.size(), &binary);
+  std::memcpy(binary.data, serialized.data(), serialized.size());
+
+  return exla::nif::ok(env, exla::nif::make(env, binary));
+}
+
+ERL_NIF_TERM deserialize_executable(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 7) {
+    return exla::nif::error(env, "Bad argument count.");
+  }
+
+  exla::ExlaClient** client;
+  std::string serialized;
+  std::vector<xla::Shape*> argument_layouts;
+  xla::ExecutableBuildOptions build_options;
+  int num_replicas;
+  int num_partitions;
+  bool use_spmd;
+  int device_id;
+
+  if (!exla::nif::get<exla::ExlaClient*>(env, argv[0], client)) {
+    return exla::nif::error(env, "Unable to get client.");
+  }
+  if (!exla::nif::get(env, argv[1], serialized)) {
+    return exla::nif::error(env, "Unable to get serialized executable.");
+  }
+  if (!exla::nif::get_list<xla::Shape>(env, argv[2], argument_layouts)) {
+    return exla::nif::error(env, "Unable to get argument layouts.");
+  }
+  if (!exla::nif::get(env, argv[3], &num_replicas)) {
+    return exla::nif::error(env, "Unable to get Number of Replicas.");
+  }
+  if (!exla::nif::get(env, argv[4], &num_partitions)) {
+    return exla::nif::error(env, "Unable to get Number of Partitions.");
+  }
+  if (!exla::nif::get(env, argv[5], &use_spmd)) {
+    return exla::nif::error(env, "Unable to get SPMD Partitioning Flag.");
+  }
+  if (!exla::nif::get(env, argv[6], &device_id)) {
+    return exla::nif::error(env, "Unable to get device ID.");
+  }
 
   build_options.set_num_replicas(num_replicas);
   build_options.set_num_partitions(num_partitions);
@@ -2170,14 +2888,14 @@ ERL_NIF_TERM compile(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
   }
 
   EXLA_ASSIGN_OR_RETURN_NIF(exla::ExlaExecutable* executable,
-    (*client)->Compile(*computation, argument_layouts, build_options, compile_portable_executable), env);
+    (*client)->DeserializeExecutable(serialized, argument_layouts, build_options, compile_portable_executable), env);
 
   return exla::nif::ok(env, exla::nif::make<exla::ExlaExecutable*>(env, executable));
 }
 
 // ExlaExecutable Functions
 
-ERL_NIF_TERM run(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+ERL_NIF_TERM run_async(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
   if (argc != 5) {
     return exla::nif::error(env, "Bad argument count.");
   }
@@ -2186,8 +2904,7 @@ ERL_NIF_TERM run(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
   exla::ExlaExecutable** executable;
   bool keep_on_device;
   int device_id;
-
-  ERL_NIF_TERM arguments = argv[2];
+  ErlNifPid pid;
 
   if (!exla::nif::get<exla::ExlaClient*>(env, argv[0], client)) {
     return exla::nif::error(env, "Unable to get client.");
@@ -2195,17 +2912,30 @@ ERL_NIF_TERM run(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
   if (!exla::nif::get<exla::ExlaExecutable*>(env, argv[1], executable)) {
     return exla::nif::error(env, "Unable to get executable.");
   }
+  if (!enif_is_list(env, argv[2])) {
+    return exla::nif::error(env, "Unable to get arguments.");
+  }
   if (!exla::nif::get(env, argv[3], &keep_on_device)) {
     return exla::nif::error(env, "Unable to get keep on device flag.");
   }
   if (!exla::nif::get(env, argv[4], &device_id)) {
     return exla::nif::error(env, "Unable to get device ID.");
   }
+  if (!enif_self(env, &pid)) {
+    return exla::nif::error(env, "Unable to get caller pid.");
+  }
+
+  // Copying the executable and the arguments into the message env
+  // keeps their resources and binaries alive until the run is done
+  ErlNifEnv* msg_env = enif_alloc_env();
+  ERL_NIF_TERM ref = enif_make_ref(env);
+  ERL_NIF_TERM msg_ref = enif_make_copy(msg_env, ref);
+  enif_make_copy(msg_env, argv[1]);
+  ERL_NIF_TERM arguments = enif_make_copy(msg_env, argv[2]);
 
-  EXLA_ASSIGN_OR_RETURN_NIF(ERL_NIF_TERM term,
-     (*executable)->Run(env, arguments, keep_on_device, device_id), env);
+  (*executable)->RunAsync(pid, msg_env, msg_ref, arguments, keep_on_device, device_id);
 
-  return term;
+  return exla::nif::ok(env, ref);
 }
 
 // Logging Functions
@@ -2237,24 +2967,39 @@ static ErlNifFunc exla_funcs[] = {
   // XlaBuilder
   {"new_builder", 1, new_builder},
   {"create_sub_builder", 2, create_sub_builder},
-  {"build", 2, build},
-  {"parameter", 4, parameter},
+  {"build", 3, build},
+  {"parameter", 5, parameter},
+  {"sharding", 2, sharding},
+  {"build_tape", 3, build_tape, ERL_NIF_DIRTY_JOB_CPU_BOUND},
   // ExlaClient
   {"get_host_client", 0, get_host_client},
   {"get_gpu_client", 2, get_gpu_client},
   {"get_tpu_client", 0, get_tpu_client},
   {"get_device_count", 1, get_device_count},
   {"get_supported_platforms", 0, get_supported_platforms},
-  {"compile", 7, compile},
+  {"get_memory_stats", 2, get_memory_stats},
+  {"set_memory_budget", 2, set_memory_budget, ERL_NIF_DIRTY_JOB_IO_BOUND},
+  {"compile_async", 7, compile_async},
+  {"serialize_computation", 1, serialize_computation, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+  {"computation_from_hlo_proto", 1, computation_from_hlo_proto, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+  {"computation_from_hlo_text", 1, computation_from_hlo_text, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+  {"computation_to_hlo_text", 2, computation_to_hlo_text, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+  {"get_program_shape", 1, get_program_shape},
+  {"get_executable_size", 1, get_executable_size},
+  {"serialize_executable", 2, serialize_executable, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+  {"deserialize_executable", 7, deserialize_executable, ERL_NIF_DIRTY_JOB_CPU_BOUND},
   // ExlaBuffer
-  {"binary_to_device_mem", 4, binary_to_device_mem, ERL_NIF_DIRTY_JOB_IO_BOUND},
-  {"read_device_mem", 3, read_device_mem, ERL_NIF_DIRTY_JOB_IO_BOUND},
+  {"binaries_to_device_mem", 3, binaries_to_device_mem, ERL_NIF_DIRTY_JOB_IO_BOUND},
+  {"read_device_mem", 4, read_device_mem, ERL_NIF_DIRTY_JOB_IO_BOUND},
   {"deallocate_device_mem", 1, deallocate_device_mem, ERL_NIF_DIRTY_JOB_IO_BOUND},
   {"transfer_to_infeed", 3, transfer_to_infeed, ERL_NIF_DIRTY_JOB_IO_BOUND},
+  {"start_infeed_queue", 3, start_infeed_queue},
+  {"infeed_queue_push", 2, infeed_queue_push, ERL_NIF_DIRTY_JOB_IO_BOUND},
   {"transfer_from_outfeed", 5, transfer_from_outfeed, ERL_NIF_DIRTY_JOB_IO_BOUND},
+  {"start_outfeed_reader", 7, start_outfeed_reader},
+  {"outfeed_reader_ack", 1, outfeed_reader_ack},
   // ExlaExecutable
-  {"run_io", 5, run, ERL_NIF_DIRTY_JOB_IO_BOUND},
-  {"run_cpu", 5, run, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+  {"run_async", 5, run_async, ERL_NIF_DIRTY_JOB_IO_BOUND},
   // Shape
   {"make_shape", 2, make_shape},
   {"make_token_shape", 0, make_token_shape},
@@ -2364,6 +3109,13 @@ static ErlNifFunc exla_funcs[] = {
   {"concatenate", 3, concatenate},
   {"sort", 3, sort},
   {"variadic_sort", 3, variadic_sort},
+  // Collective
+  {"replica_id", 1, replica_id},
+  {"all_reduce", 3, all_reduce},
+  {"all_gather", 4, all_gather},
+  {"reduce_scatter", 5, reduce_scatter},
+  {"all_to_all", 5, all_to_all},
+  {"collective_permute", 2, collective_permute},
   // LinAlg
   {"cholesky", 1, cholesky},
   {"eigh", 2, eigh},
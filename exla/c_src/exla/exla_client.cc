@@ -1,60 +1,469 @@
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
 #include "exla_client.h"
 #include "exla_nif_util.h"
 #include "tensorflow/compiler/xla/layout_util.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/pjrt/gpu_device.h"
 #include "tensorflow/compiler/xla/pjrt/cpu_device.h"
+#include "tensorflow/compiler/xla/pjrt/pjrt_stream_executor_client.h"
 #include "tensorflow/compiler/xla/pjrt/tpu_client.h"
 #include "tensorflow/stream_executor/tpu/tpu_transfer_manager.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
+#include "absl/synchronization/notification.h"
 
 namespace exla {
 
+// Memory accounting and budget of a device. Buffers which may be
+// spilled are listed from least to most recently used.
+struct DeviceMemory {
+  ExlaMemoryStats stats;
+  std::list<ExlaBuffer*> lru;
+  // Bytes of the buffer which is being copied to the host
+  exla::int64 spilling_bytes = 0;
+};
+
+// Guards all device memory and the memory fields of all buffers
+static std::mutex memory_mutex;
+// Notified when devices go over budget and when transfers finish
+static std::condition_variable memory_cv;
+static std::map<xla::PjRtDevice*, DeviceMemory> device_memory;
+// Devices over budget, waiting for the spill worker
+static std::set<xla::PjRtDevice*> devices_to_spill;
+// The buffer copied by the spill worker. It is cleared if the buffer
+// is released during the copy, so the worker discards the copy.
+static ExlaBuffer* spilling_buffer = nullptr;
+
+void TrackAllocationLocked(ExlaMemoryStats& stats, exla::int64 bytes) {
+  stats.allocated_bytes += bytes;
+  stats.peak_allocated_bytes = std::max(stats.peak_allocated_bytes, stats.allocated_bytes);
+  stats.live_buffers++;
+}
+
+void TrackDeallocationLocked(ExlaMemoryStats& stats, exla::int64 bytes) {
+  stats.allocated_bytes -= bytes;
+  stats.live_buffers--;
+}
+
+bool OverBudgetLocked(const DeviceMemory& memory) {
+  return memory.stats.memory_budget > 0 &&
+    memory.stats.allocated_bytes - memory.spilling_bytes > memory.stats.memory_budget;
+}
+
+// Spills the least recently used buffers of `device` until they fit
+// the device budget. Pinned buffers are in use and are skipped. The
+// lock is released while each buffer is copied, so we look for the
+// least recently used buffer again after every spill.
+void SpillDeviceLocked(xla::PjRtDevice* device, std::unique_lock<std::mutex>& lock) {
+  DeviceMemory& memory = device_memory[device];
+
+  while (OverBudgetLocked(memory)) {
+    ExlaBuffer* victim = nullptr;
+
+    for (auto it = memory.lru.begin(); it != memory.lru.end() && !victim && OverBudgetLocked(memory);) {
+      ExlaBuffer* buffer = *it++;
+
+      // Donated buffers are deleted by XLA, so we release them here.
+      // Buffers shared with binaries cannot be deleted, so we skip them.
+      if (buffer->buffer_->IsDeleted()) {
+        buffer->ReleaseLocked();
+      } else if (buffer->pins_ == 0 && buffer->buffer_.use_count() == 1) {
+        victim = buffer;
+      }
+    }
+
+    if (!victim) return;
+
+    // The buffer is kept on the device and we try again once more memory is allocated
+    xla::Status status = victim->SpillLocked(lock);
+    if (!status.ok()) {
+      LOG(WARNING) << "Unable to spill buffer to the host: " << status.error_message();
+      return;
+    }
+  }
+}
+
+// Spills buffers of devices over budget. Copies to the host may take
+// long, so they run on this thread rather than on the threads which
+// create buffers, such as schedulers and device callbacks.
+void SpillLoop() {
+  std::unique_lock<std::mutex> lock(memory_mutex);
+
+  while (true) {
+    memory_cv.wait(lock, []() { return !devices_to_spill.empty(); });
+    xla::PjRtDevice* device = *devices_to_spill.begin();
+    devices_to_spill.erase(devices_to_spill.begin());
+    SpillDeviceLocked(device, lock);
+  }
+}
+
+// Wakes up the spill worker if `device` is over budget
+void EnforceMemoryBudgetLocked(xla::PjRtDevice* device) {
+  static std::once_flag spill_worker;
+
+  if (!OverBudgetLocked(device_memory[device])) return;
+
+  std::call_once(spill_worker, []() { std::thread(SpillLoop).detach(); });
+  devices_to_spill.insert(device);
+  memory_cv.notify_all();
+}
+
+ExlaMemoryStats GetMemoryStats(xla::PjRtDevice* device) {
+  std::lock_guard<std::mutex> lock(memory_mutex);
+  return device_memory[device].stats;
+}
+
+void SetMemoryBudget(xla::PjRtDevice* device, exla::int64 bytes) {
+  std::lock_guard<std::mutex> lock(memory_mutex);
+  device_memory[device].stats.memory_budget = bytes;
+  EnforceMemoryBudgetLocked(device);
+}
+
 ExlaBuffer::ExlaBuffer(std::unique_ptr<xla::PjRtBuffer> buffer,
-                       bool can_be_released_after_run): buffer_(std::move(buffer)),
-                                                        can_be_released_after_run_(can_be_released_after_run) {}
+                       bool can_be_released_after_run,
+                       bool aliases_binary): buffer_(std::move(buffer)),
+                                             can_be_released_after_run_(can_be_released_after_run),
+                                             aliases_binary_(aliases_binary) {
+  device_ = buffer_->device();
+  bytes_ = xla::ShapeUtil::ByteSizeOf(buffer_->on_device_shape());
+
+  std::lock_guard<std::mutex> lock(memory_mutex);
+  DeviceMemory& memory = device_memory[device_];
+  TrackAllocationLocked(memory.stats, bytes_);
+  memory.stats.total_allocations++;
+  memory.stats.total_allocated_bytes += bytes_;
+
+  // Binary aliases hold the binary memory and temporary buffers
+  // are released after the run, so neither of them is spilled
+  if (!aliases_binary_ && !can_be_released_after_run_) {
+    lru_position_ = memory.lru.insert(memory.lru.end(), this);
+    spillable_ = true;
+  }
+
+  EnforceMemoryBudgetLocked(device_);
+}
+
+ExlaBuffer::~ExlaBuffer() {
+  std::lock_guard<std::mutex> lock(memory_mutex);
+  ReleaseLocked();
+}
+
+void ExlaBuffer::ReleaseLocked() {
+  if (released_) return;
+
+  DeviceMemory& memory = device_memory[device_];
+
+  if (spilled_) {
+    memory.stats.spilled_bytes -= bytes_;
+    memory.stats.spilled_buffers--;
+    spilled_.reset();
+  } else if (spilling_buffer == this) {
+    // The spill worker holds the buffer until its copy is done
+    // and then discards it, so we do not wait for it
+    spilling_buffer = nullptr;
+    memory.spilling_bytes -= bytes_;
+    TrackDeallocationLocked(memory.stats, bytes_);
+  } else {
+    TrackDeallocationLocked(memory.stats, bytes_);
+    if (spillable_) memory.lru.erase(lru_position_);
+  }
+
+  released_ = true;
+}
+
+// Buffers are taken out of the list while they are copied, so they
+// are not spilled twice, and pinning waits for the copy to finish.
+// The buffer may be released, and even destroyed, during the copy,
+// so we only touch it again if it is still the spilling buffer.
+xla::Status ExlaBuffer::SpillLocked(std::unique_lock<std::mutex>& lock) {
+  DeviceMemory& memory = device_memory[device_];
+  memory.lru.erase(lru_position_);
+  memory.spilling_bytes += bytes_;
+  spilling_buffer = this;
+
+  std::shared_ptr<xla::PjRtBuffer> buffer = buffer_;
+  exla::int64 bytes = bytes_;
+
+  lock.unlock();
+  xla::StatusOr<std::shared_ptr<xla::Literal>> literal = buffer->ToLiteral();
+  lock.lock();
+
+  memory_cv.notify_all();
+  if (spilling_buffer != this) return xla::Status::OK();
+
+  spilling_buffer = nullptr;
+  memory.spilling_bytes -= bytes;
+
+  if (!literal.ok()) {
+    lru_position_ = memory.lru.insert(memory.lru.end(), this);
+    return literal.status();
+  }
+
+  buffer_->Delete();
+  spilled_ = literal.ConsumeValueOrDie();
+
+  TrackDeallocationLocked(memory.stats, bytes_);
+  memory.stats.spilled_bytes += bytes_;
+  memory.stats.spilled_buffers++;
+  memory.stats.total_spills++;
+
+  return xla::Status::OK();
+}
+
+// Only called when pinning, whose caller holds a reference to the
+// buffer, so it is not destroyed during the copy. It may still be
+// deallocated, in which case the restored buffer is discarded.
+xla::Status ExlaBuffer::RestoreLocked(std::unique_lock<std::mutex>& lock) {
+  std::shared_ptr<xla::Literal> spilled = spilled_;
+  xla::PjRtClient* client = buffer_->client();
+  restoring_ = true;
+
+  lock.unlock();
+  xla::StatusOr<std::unique_ptr<xla::PjRtBuffer>> buffer =
+    client->BufferFromHostLiteral(*spilled, device_);
+  // The literal must be alive until the transfer completes
+  xla::Status status = buffer.ok() ? buffer.ValueOrDie()->BlockHostUntilReady() : buffer.status();
+  lock.lock();
+
+  restoring_ = false;
+  memory_cv.notify_all();
+
+  if (!status.ok()) return status;
+
+  if (released_) {
+    return xla::FailedPrecondition("Attempt to use deallocated buffer.");
+  }
+
+  buffer_ = buffer.ConsumeValueOrDie();
+  spilled_.reset();
+
+  DeviceMemory& memory = device_memory[device_];
+  TrackAllocationLocked(memory.stats, bytes_);
+  memory.stats.spilled_bytes -= bytes_;
+  memory.stats.spilled_buffers--;
+  lru_position_ = memory.lru.insert(memory.lru.end(), this);
+
+  return xla::Status::OK();
+}
 
-void CopyLiteralToBinary(xla::Literal* literal, ErlNifBinary* binary, exla::int64 size) {
-  exla::int64 actual_size = literal->size_bytes();
-  if(size < 0 or size > actual_size) size = actual_size;
+xla::StatusOr<xla::PjRtBuffer*> ExlaBuffer::Pin() {
+  std::unique_lock<std::mutex> lock(memory_mutex);
+  memory_cv.wait(lock, [this]() { return !restoring_ && spilling_buffer != this; });
+
+  if (spilled_) {
+    EXLA_EFFECT_OR_RETURN(RestoreLocked(lock));
+    // Pinned first, so the restored buffer is not spilled again
+    pins_++;
+    EnforceMemoryBudgetLocked(device_);
+    return buffer_.get();
+  }
+
+  if (spillable_ && !released_) {
+    std::list<ExlaBuffer*>& lru = device_memory[device_].lru;
+    lru.splice(lru.end(), lru, lru_position_);
+  }
+
+  pins_++;
+  return buffer_.get();
+}
+
+void ExlaBuffer::Unpin() {
+  std::lock_guard<std::mutex> lock(memory_mutex);
+  pins_--;
+
+  // Donated buffers are deleted by XLA once the execution is enqueued,
+  // so their memory is released now rather than on the next spill
+  if (pins_ == 0 && !released_ && !spilled_ && buffer_->IsDeleted()) {
+    ReleaseLocked();
+  }
+}
+
+// Keeps buffers pinned while they are read or until the execution
+// using them is enqueued, which holds on to their memory from then on
+struct ExlaBufferPins {
+  std::vector<ExlaBuffer*> buffers;
+
+  ~ExlaBufferPins() {
+    for (auto buffer : buffers) buffer->Unpin();
+  }
+};
+
+// Clamps `offset` and `size` to the `actual_size` of a buffer. A
+// negative size reads everything from the offset onwards.
+void ClampRange(exla::int64 actual_size, exla::int64* offset, exla::int64* size) {
+  if (*offset < 0 || *offset > actual_size) *offset = actual_size;
+  if (*size < 0 || *size > actual_size - *offset) *size = actual_size - *offset;
+}
+
+void CopyLiteralToBinary(xla::Literal* literal, ErlNifBinary* binary, exla::int64 offset, exla::int64 size) {
+  ClampRange(literal->size_bytes(), &offset, &size);
   enif_alloc_binary(size, binary);
-  std::memcpy(binary->data, literal->untyped_data(), size);
+  std::memcpy(binary->data, reinterpret_cast<char*>(literal->untyped_data()) + offset, size);
 }
 
-xla::StatusOr<ERL_NIF_TERM> ExlaBuffer::ToBinary(ErlNifEnv* env, exla::int64 size) {
-  EXLA_EFFECT_OR_RETURN(buffer_->BlockHostUntilReady());
-  EXLA_ASSIGN_OR_RETURN(std::shared_ptr<xla::Literal> literal, buffer_->ToLiteral());
+// Returns a binary pointing directly to the memory of a host buffer,
+// without copying it. The binary holds an external reference to the
+// memory and shares ownership of the PjRt buffer, so the memory is
+// valid until the binary is collected, even if the ExlaBuffer is
+// deallocated before.
+xla::StatusOr<ERL_NIF_TERM> MakeHostBufferBinary(ErlNifEnv* env,
+                                                 std::shared_ptr<xla::PjRtBuffer> buffer,
+                                                 exla::int64 offset,
+                                                 exla::int64 size) {
+  ClampRange(xla::ShapeUtil::ByteSizeOf(buffer->on_device_shape()), &offset, &size);
 
-  ErlNifBinary binary;
+  EXLA_ASSIGN_OR_RETURN(std::unique_ptr<xla::PjRtBuffer::ExternalReference> reference,
+    buffer->AcquireExternalReference());
+  char* data = reinterpret_cast<char*>(reference->OpaqueDeviceMemoryDataPointer()) + offset;
 
-  xla::Shape host_shape = xla::ShapeUtil::MakeShape(buffer_->on_device_shape().element_type(), buffer_->on_device_shape().dimensions());
+  void* ptr = enif_alloc_resource(nif::resource_object<ExlaExternalReference>::type,
+                                  sizeof(ExlaExternalReference));
+  new(ptr) ExlaExternalReference{std::move(buffer), std::move(reference)};
+  ERL_NIF_TERM term = enif_make_resource_binary(env, ptr, data, size);
+  enif_release_resource(ptr);
+
+  return term;
+}
+
+// Transfers only the requested range of a device buffer to the host.
+xla::Status CopyRawRangeToBinary(xla::PjRtBuffer* buffer,
+                                 ErlNifBinary* binary,
+                                 exla::int64 offset,
+                                 exla::int64 size) {
+  ClampRange(xla::ShapeUtil::ByteSizeOf(buffer->on_device_shape()), &offset, &size);
+
+  if (!enif_alloc_binary(size, binary)) {
+    return xla::ResourceExhausted("Unable to allocate binary of %lld bytes.",
+                                  static_cast<long long>(size));
+  }
+
+  absl::Notification done;
+  xla::Status transfer_status;
+
+  xla::Status status = buffer->CopyRawToHost(binary->data, offset, size, [&](xla::Status s) {
+    transfer_status = s;
+    done.Notify();
+  });
+
+  if (status.ok()) {
+    done.WaitForNotification();
+    status = transfer_status;
+  }
+
+  if (!status.ok()) {
+    enif_release_binary(binary);
+  }
+
+  return status;
+}
+
+// Copies a literal of a buffer with the given device shape to a binary
+ERL_NIF_TERM LiteralToBinary(ErlNifEnv* env,
+                             xla::Literal* literal,
+                             const xla::Shape& device_shape,
+                             exla::int64 offset,
+                             exla::int64 size) {
+  ErlNifBinary binary;
+  xla::Shape host_shape = xla::ShapeUtil::MakeShape(device_shape.element_type(), device_shape.dimensions());
 
   if (xla::LayoutUtil::LayoutsInShapesEqual(host_shape, literal->shape())) {
-    CopyLiteralToBinary(literal.get(), &binary, size);
+    CopyLiteralToBinary(literal, &binary, offset, size);
   } else {
     xla::Literal new_literal = literal->Relayout(host_shape);
-    CopyLiteralToBinary(&new_literal, &binary, size);
+    CopyLiteralToBinary(&new_literal, &binary, offset, size);
   }
 
   return nif::make(env, binary);
 }
 
+xla::StatusOr<ERL_NIF_TERM> ExlaBuffer::ToBinary(ErlNifEnv* env, exla::int64 offset, exla::int64 size) {
+  // Spilled buffers are read from the host, without restoring them
+  std::shared_ptr<xla::Literal> spilled;
+  {
+    std::lock_guard<std::mutex> lock(memory_mutex);
+    spilled = spilled_;
+  }
+
+  if (spilled) {
+    return LiteralToBinary(env, spilled.get(), spilled->shape(), offset, size);
+  }
+
+  EXLA_ASSIGN_OR_RETURN(xla::PjRtBuffer* buffer, Pin());
+  ExlaBufferPins pins{{this}};
+
+  EXLA_EFFECT_OR_RETURN(buffer->BlockHostUntilReady());
+
+  const xla::Shape& device_shape = buffer->on_device_shape();
+  bool is_row_major = device_shape.IsArray() &&
+    xla::LayoutUtil::IsMonotonicWithDim0Major(device_shape.layout());
+
+  // Pinned buffers are never spilled, so buffer_ is the pinned buffer
+  if (is_row_major && buffer->IsOnCpu()) {
+    return MakeHostBufferBinary(env, buffer_, offset, size);
+  }
+
+  ErlNifBinary binary;
+
+  // Raw bytes only map to the host layout when the device is row-major.
+  // Not all platforms implement raw copies, so we fallback to literals.
+  if (is_row_major && CopyRawRangeToBinary(buffer, &binary, offset, size).ok()) {
+    return nif::make(env, binary);
+  }
+
+  EXLA_ASSIGN_OR_RETURN(std::shared_ptr<xla::Literal> literal, buffer->ToLiteral());
+  return LiteralToBinary(env, literal.get(), device_shape, offset, size);
+}
+
 xla::Status ExlaBuffer::BlockHostUntilReady() {
-  return buffer_->BlockHostUntilReady();
+  EXLA_ASSIGN_OR_RETURN(xla::PjRtBuffer* buffer, Pin());
+  ExlaBufferPins pins{{this}};
+  return buffer->BlockHostUntilReady();
 }
 
 xla::Status ExlaBuffer::Deallocate() {
-  if (buffer_->IsDeleted()) {
+  std::lock_guard<std::mutex> lock(memory_mutex);
+
+  if (released_ || (!spilled_ && buffer_->IsDeleted())) {
     return xla::FailedPrecondition("Attempt to deallocate already deallocated buffer.");
   }
   else {
-    buffer_->Delete();
+    // Binaries pointing to the buffer memory keep it alive, so
+    // it is freed once the last of them is collected instead
+    if (!spilled_ && buffer_.use_count() == 1) buffer_->Delete();
+    ReleaseLocked();
     return xla::Status::OK();
   }
 }
 
+// Copies a buffer which aliases a binary into a buffer which owns
+// its memory and is released after the run.
+xla::StatusOr<ExlaBuffer*> CopyBinaryAlias(ExlaClient* client, ExlaBuffer* buffer) {
+  xla::PjRtBuffer* pjrt_buffer = buffer->buffer();
+  EXLA_ASSIGN_OR_RETURN(std::unique_ptr<xla::PjRtBuffer::ExternalReference> reference,
+    pjrt_buffer->AcquireExternalReference());
+
+  xla::PjRtClient::HostBufferSemantics semantics = xla::PjRtClient::HostBufferSemantics::kImmutableUntilTransferCompletes;
+  EXLA_ASSIGN_OR_RETURN(std::unique_ptr<xla::PjRtBuffer> copy,
+    client->client()->BufferFromHostBuffer(reference->OpaqueDeviceMemoryDataPointer(),
+                                           pjrt_buffer->on_device_shape(),
+                                           semantics,
+                                           nullptr,
+                                           pjrt_buffer->device()));
+
+  return new ExlaBuffer(std::move(copy), true);
+}
+
 xla::StatusOr<std::vector<ExlaBuffer*>> UnpackRunArguments(ErlNifEnv* env,
                                                            ERL_NIF_TERM arguments,
                                                            ExlaClient* client,
-                                                           int device_id) {
+                                                           int device_id,
+                                                           const std::set<exla::int64>& donated_parameters) {
   unsigned int length;
   if (!enif_get_list_length(env, arguments, &length)) {
     return xla::InvalidArgument("Argument is not a list.");
@@ -64,38 +473,50 @@ xla::StatusOr<std::vector<ExlaBuffer*>> UnpackRunArguments(ErlNifEnv* env,
   arg_buffers.reserve(length);
 
   ERL_NIF_TERM head, tail;
+  exla::int64 parameter_number = 0;
   while (enif_get_list_cell(env, arguments, &head, &tail)) {
     const ERL_NIF_TERM* tuple;
     int arity;
     ExlaBuffer** buffer;
 
     if (enif_get_tuple(env, head, &arity, &tuple)) {
-      ErlNifBinary data;
       xla::Shape* shape;
 
-      if (!nif::get_binary(env, tuple[0], &data)) {
+      if (!enif_is_binary(env, tuple[0])) {
         return xla::InvalidArgument("Expected argument to be binary.");
       }
       if (!nif::get<xla::Shape>(env, tuple[1], shape)) {
         return xla::InvalidArgument("Expected argument to be shape reference.");
       }
 
-      EXLA_ASSIGN_OR_RETURN(ExlaBuffer* buf, client->BufferFromBinary(data, *shape, device_id, true));
+      // XLA writes into donated buffers, so they cannot alias the binary
+      bool zero_copy = donated_parameters.count(parameter_number) == 0;
+      EXLA_ASSIGN_OR_RETURN(ExlaBuffer* buf,
+        client->BufferFromBinary(env, tuple[0], *shape, device_id, true, zero_copy));
 
       arg_buffers.push_back(buf);
 
     } else if (nif::get<ExlaBuffer*>(env, head, buffer)) {
-      arg_buffers.push_back(*buffer);
+      if ((*buffer)->aliases_binary() && donated_parameters.count(parameter_number)) {
+        // XLA writes into donated buffers, so we donate a copy instead
+        EXLA_ASSIGN_OR_RETURN(ExlaBuffer* copy, CopyBinaryAlias(client, *buffer));
+        arg_buffers.push_back(copy);
+      } else {
+        arg_buffers.push_back(*buffer);
+      }
     } else {
       return xla::InvalidArgument("Expected argument to be buffer reference.");
     }
     arguments = tail;
+    parameter_number++;
   }
 
   return arg_buffers;
 }
 
-xla::StatusOr<ERL_NIF_TERM> UnpackResult(ErlNifEnv* env, std::vector<std::unique_ptr<xla::PjRtBuffer>> result, bool keep_on_device) {
+xla::StatusOr<ERL_NIF_TERM> UnpackResult(ErlNifEnv* env,
+                                         std::vector<std::unique_ptr<xla::PjRtBuffer>> result,
+                                         bool keep_on_device) {
   std::vector<ERL_NIF_TERM> terms;
   terms.reserve(result.size());
   for (auto& pjrt_buf : result) {
@@ -104,43 +525,34 @@ xla::StatusOr<ERL_NIF_TERM> UnpackResult(ErlNifEnv* env, std::vector<std::unique
     if (keep_on_device) {
       term = nif::make<ExlaBuffer*>(env, buf);
     } else {
-      EXLA_ASSIGN_OR_RETURN_NIF(term, buf->ToBinary(env, -1), env);
+      auto statusor = buf->ToBinary(env, 0, -1);
       delete buf;
+      EXLA_ASSIGN_OR_RETURN(term, std::move(statusor));
     }
     terms.push_back(term);
   }
-  return nif::ok(env, enif_make_tuple2(env, enif_make_list_from_array(env, &terms[0], terms.size()), enif_make_int(env, 0)));
+  return enif_make_list_from_array(env, terms.data(), terms.size());
 }
 
-ExlaExecutable::ExlaExecutable(std::unique_ptr<xla::PjRtExecutable> executable,
-			                         absl::optional<std::string> fingerprint,
-			                         ExlaClient* client) : executable_(std::move(executable)),
-                                                     fingerprint_(std::move(fingerprint)),
-                                                     client_(client) {}
-
-xla::StatusOr<ERL_NIF_TERM> ExlaExecutable::Run(ErlNifEnv* env,
-                                                ERL_NIF_TERM arguments,
-                                                bool keep_on_device,
-                                                int device_id) {
-  xla::ExecuteOptions options;
-  options.untuple_result = true;
-  options.strict_shape_checking = false;
-
-  std::vector<ExlaBuffer*> input_buffers;
-  if (device_id >= 0) {
-    EXLA_ASSIGN_OR_RETURN_NIF(input_buffers, UnpackRunArguments(env, arguments, client_, device_id), env);
-  } else {
-    // TODO(seanmor5): With pmap, this should unpack to all devices
-    EXLA_ASSIGN_OR_RETURN_NIF(input_buffers, UnpackRunArguments(env, arguments, client_, 0), env);
-  }
+// Unpacks the arguments of a single replica into buffers on the given device.
+// Arguments are pinned, so they are moved back to the device if they
+// were spilled and they are not spilled until the execution is enqueued.
+xla::StatusOr<std::vector<xla::PjRtBuffer*>> PrepareRunArguments(ErlNifEnv* env,
+                                                                 ERL_NIF_TERM arguments,
+                                                                 ExlaClient* client,
+                                                                 int device_id,
+                                                                 const std::set<exla::int64>& donated_parameters,
+                                                                 ExlaBufferPins& pins) {
+  EXLA_ASSIGN_OR_RETURN(std::vector<ExlaBuffer*> input_buffers,
+    UnpackRunArguments(env, arguments, client, device_id, donated_parameters));
 
   std::vector<xla::PjRtBuffer*> pjrt_buffers;
-  std::vector<ERL_NIF_TERM> terms;
   pjrt_buffers.reserve(input_buffers.size());
-  terms.reserve(input_buffers.size());
 
   for (auto buf : input_buffers) {
-    pjrt_buffers.push_back(buf->buffer());
+    EXLA_ASSIGN_OR_RETURN(xla::PjRtBuffer* pjrt_buffer, buf->Pin());
+    pins.buffers.push_back(buf);
+    pjrt_buffers.push_back(pjrt_buffer);
 
     // If the buffer was not received as a resource (e.g. we converted
     // it from a binary to a buffer), we need to make sure it has been
@@ -148,44 +560,269 @@ xla::StatusOr<ERL_NIF_TERM> ExlaExecutable::Run(ErlNifEnv* env,
     // so it's tracked and GC'ed along with other buffers that are no
     // longer in use
     if (buf->release_after_run()) {
-      EXLA_EFFECT_OR_RETURN_NIF(buf->BlockHostUntilReady(), env);
-      terms.push_back(nif::make<ExlaBuffer*>(env, buf));
+      nif::make<ExlaBuffer*>(env, buf);
+      EXLA_EFFECT_OR_RETURN(buf->BlockHostUntilReady());
     }
   }
 
-  ERL_NIF_TERM ret;
+  return pjrt_buffers;
+}
+
+ExlaExecutable::ExlaExecutable(std::unique_ptr<xla::PjRtExecutable> executable,
+			                         absl::optional<std::string> fingerprint,
+			                         ExlaClient* client) : executable_(std::move(executable)),
+                                                     fingerprint_(std::move(fingerprint)),
+                                                     client_(client) {
+  auto modules = executable_->GetHloModules();
+
+  if (modules.ok() && !modules.ValueOrDie().empty()) {
+    const xla::HloInputOutputAliasConfig& config = modules.ValueOrDie()[0]->input_output_alias_config();
+    config.ForEachAlias([this](const xla::ShapeIndex& output_index,
+                               const xla::HloInputOutputAliasConfig::Alias& alias) {
+      donated_parameters_.insert(alias.parameter_number);
+    });
+  }
+
+  // Backends report the size of their generated code. Where they
+  // do not, the size of the optimized HLO is the best estimate.
+  auto se_executable = dynamic_cast<xla::PjRtStreamExecutorExecutable*>(executable_.get());
+  if (se_executable != nullptr) {
+    for (const auto& local_executable : se_executable->executables()) {
+      size_bytes_ += std::max<exla::int64>(local_executable->executable()->SizeOfGeneratedCodeInBytes(), 0);
+    }
+  }
+
+  if (size_bytes_ == 0 && modules.ok()) {
+    for (const auto& module : modules.ValueOrDie()) {
+      size_bytes_ += module->ToProto().ByteSizeLong();
+    }
+  }
+}
+
+xla::StatusOr<std::vector<ExlaReplicaResult>> ExlaExecutable::Execute(ErlNifEnv* env,
+                                                                      ERL_NIF_TERM arguments,
+                                                                      int device_id) {
+  xla::ExecuteOptions options;
+  options.untuple_result = true;
+  options.strict_shape_checking = false;
+  ExlaBufferPins pins;
+  std::vector<ExlaReplicaResult> results;
 
   if (device_id >= 0) {
-    EXLA_ASSIGN_OR_RETURN_NIF(xla::PjRtDevice* device, client_->client()->LookupDevice(device_id), env);
-    EXLA_ASSIGN_OR_RETURN_NIF(auto result, executable_->ExecutePortable(pjrt_buffers, device, options), env);
-    EXLA_ASSIGN_OR_RETURN_NIF(ret, UnpackResult(env, std::move(result), keep_on_device), env);
+    EXLA_ASSIGN_OR_RETURN(std::vector<xla::PjRtBuffer*> pjrt_buffers,
+      PrepareRunArguments(env, arguments, client_, device_id, donated_parameters_, pins));
+    EXLA_ASSIGN_OR_RETURN(xla::PjRtDevice* device, client_->client()->LookupDevice(device_id));
+    EXLA_ASSIGN_OR_RETURN(auto result, executable_->ExecutePortable(pjrt_buffers, device, options));
+    results.push_back({std::move(result), device_id});
+    return results;
+  }
+
+  // Replicated executables receive one list of arguments per replica,
+  // each placed on the device its replica runs on, and return one list
+  // of results per replica.
+  const std::vector<xla::PjRtDevice*>& devices = executable_->addressable_devices();
+  unsigned int num_replicas;
+
+  if (!enif_get_list_length(env, arguments, &num_replicas) || num_replicas != devices.size()) {
+    return xla::InvalidArgument("Expected one list of arguments per replica.");
+  }
+
+  std::vector<std::vector<xla::PjRtBuffer*>> inputs;
+  inputs.reserve(num_replicas);
+
+  ERL_NIF_TERM head, tail;
+  for (auto device : devices) {
+    enif_get_list_cell(env, arguments, &head, &tail);
+    EXLA_ASSIGN_OR_RETURN(std::vector<xla::PjRtBuffer*> pjrt_buffers,
+      PrepareRunArguments(env, head, client_, device->id(), donated_parameters_, pins));
+    inputs.push_back(std::move(pjrt_buffers));
+    arguments = tail;
+  }
+
+  EXLA_ASSIGN_OR_RETURN(auto outputs, executable_->Execute(inputs, options));
+
+  for (int i = 0; i < outputs.size(); i++) {
+    results.push_back({std::move(outputs.at(i)), devices.at(i)->id()});
+  }
+
+  return results;
+}
+
+// Single device runs return `{results, device_id}`, replicated
+// runs return a list with one such tuple per replica.
+xla::StatusOr<ERL_NIF_TERM> UnpackResults(ErlNifEnv* env,
+                                          std::vector<ExlaReplicaResult> results,
+                                          bool keep_on_device,
+                                          bool replicated) {
+  std::vector<ERL_NIF_TERM> terms;
+  terms.reserve(results.size());
+
+  for (auto& result : results) {
+    EXLA_ASSIGN_OR_RETURN(ERL_NIF_TERM ret, UnpackResult(env, std::move(result.buffers), keep_on_device));
+    terms.push_back(enif_make_tuple2(env, ret, enif_make_int(env, result.device_id)));
+  }
+
+  if (replicated) {
+    return enif_make_list_from_array(env, terms.data(), terms.size());
   } else {
-    std::vector<std::vector<xla::PjRtBuffer*>> inputs = std::vector<std::vector<xla::PjRtBuffer*>>({pjrt_buffers});
-    EXLA_ASSIGN_OR_RETURN_NIF(auto result, executable_->Execute(inputs, options), env);
-    EXLA_ASSIGN_OR_RETURN_NIF(ret, UnpackResult(env, std::move(result.at(0)), keep_on_device), env);
+    return terms.at(0);
   }
+}
 
-  return ret;
+// Waits for all outputs of a run and unpacks them
+xla::StatusOr<ERL_NIF_TERM> AwaitResults(ErlNifEnv* env,
+                                         xla::StatusOr<std::vector<ExlaReplicaResult>> statusor,
+                                         bool keep_on_device,
+                                         bool replicated) {
+  EXLA_ASSIGN_OR_RETURN(std::vector<ExlaReplicaResult> results, std::move(statusor));
+
+  for (auto& result : results) {
+    for (auto& buffer : result.buffers) {
+      EXLA_EFFECT_OR_RETURN(buffer->BlockHostUntilReady());
+    }
+  }
+
+  return UnpackResults(env, std::move(results), keep_on_device, replicated);
 }
 
-ExlaClient::ExlaClient(std::shared_ptr<xla::PjRtClient> client) : client_(std::move(client)) {}
+void ExlaExecutable::RunAsync(ErlNifPid pid,
+                              ErlNifEnv* msg_env,
+                              ERL_NIF_TERM ref,
+                              ERL_NIF_TERM arguments,
+                              bool keep_on_device,
+                              int device_id) {
+  // Binaries and resources in the arguments are owned by msg_env,
+  // so they are valid for as long as this execution needs them
+  auto statusor = std::make_shared<xla::StatusOr<std::vector<ExlaReplicaResult>>>(
+    Execute(msg_env, arguments, device_id));
+  bool replicated = device_id < 0;
+
+  // The execution is enqueued in the caller, so runs keep their order,
+  // and the wait for its outputs happens in the pool. Sending from a
+  // pool thread is required as enif_send with no env can only be called
+  // from threads which are not scheduler threads, dirty ones included.
+  client_->read_thread_pool()->Schedule([=]() {
+    auto result = AwaitResults(msg_env, std::move(*statusor), keep_on_device, replicated);
+    ERL_NIF_TERM term;
+
+    if (result.ok()) {
+      term = nif::ok(msg_env, result.ValueOrDie());
+    } else {
+      term = nif::error(msg_env, result.status().error_message().c_str());
+    }
 
-xla::StatusOr<ExlaBuffer*> ExlaClient::BufferFromBinary(const ErlNifBinary& binary,
+    enif_send(NULL, &pid, msg_env, enif_make_tuple2(msg_env, ref, term));
+    enif_free_env(msg_env);
+  });
+}
+
+ExlaClient::ExlaClient(std::shared_ptr<xla::PjRtClient> client) : client_(std::move(client)) {
+  // XLA parallelizes compilation internally, so we only need enough
+  // threads to compile a few distinct computations concurrently
+  int num_compile_threads = std::max(1, std::min(4, tensorflow::port::MaxParallelism()));
+  compile_thread_pool_ = absl::make_unique<tensorflow::thread::ThreadPool>(
+    tensorflow::Env::Default(), "exla_compile", num_compile_threads);
+
+  int num_read_threads = std::max(client_->device_count(), tensorflow::port::MaxParallelism());
+  read_thread_pool_ = absl::make_unique<tensorflow::thread::ThreadPool>(
+    tensorflow::Env::Default(), "exla_read", num_read_threads);
+}
+
+xla::StatusOr<ExlaBuffer*> ExlaClient::BufferFromBinary(ErlNifEnv* env,
+                                                        ERL_NIF_TERM source_term,
                                                         xla::Shape& shape,
                                                         int device_id,
-                                                        bool can_be_released_after_run) {
-  xla::PjRtClient::HostBufferSemantics semantics = xla::PjRtClient::HostBufferSemantics::kImmutableUntilTransferCompletes;
-
+                                                        bool can_be_released_after_run,
+                                                        bool zero_copy) {
   EXLA_ASSIGN_OR_RETURN(xla::PjRtDevice* device, client_->LookupDevice(device_id));
+
+  if (zero_copy && IsHostPlatform()) {
+    // Copying the term into its own env keeps a reference to the binary,
+    // which is released once PjRt is done with the host memory. Note we
+    // must inspect the copy, as small binaries live on the process heap
+    // and are copied rather than referenced.
+    ErlNifEnv* binary_env = enif_alloc_env();
+    ERL_NIF_TERM binary_term = enif_make_copy(binary_env, source_term);
+    ErlNifBinary binary;
+
+    if (!nif::get_binary(binary_env, binary_term, &binary)) {
+      enif_free_env(binary_env);
+      return xla::InvalidArgument("Expected argument to be binary.");
+    }
+
+    // PjRt falls back to a copy if the data is not suitably aligned
+    xla::PjRtClient::HostBufferSemantics semantics = xla::PjRtClient::HostBufferSemantics::kZeroCopy;
+    std::function<void()> on_done_with_host_buffer = [binary_env]() { enif_free_env(binary_env); };
+
+    auto statusor = client_->BufferFromHostBuffer(binary.data, shape, semantics, on_done_with_host_buffer, device);
+
+    if (!statusor.ok()) {
+      enif_free_env(binary_env);
+      return statusor.status();
+    }
+
+    return new ExlaBuffer(std::move(statusor.ValueOrDie()), can_be_released_after_run, true);
+  }
+
+  ErlNifBinary binary;
+  if (!nif::get_binary(env, source_term, &binary)) {
+    return xla::InvalidArgument("Expected argument to be binary.");
+  }
+
+  xla::PjRtClient::HostBufferSemantics semantics = xla::PjRtClient::HostBufferSemantics::kImmutableUntilTransferCompletes;
   EXLA_ASSIGN_OR_RETURN(auto buffer, client_->BufferFromHostBuffer(binary.data, shape, semantics, nullptr, device));
 
   return new ExlaBuffer(std::move(buffer), can_be_released_after_run);
 }
 
-xla::StatusOr<ExlaExecutable*> ExlaClient::Compile(const xla::XlaComputation& computation,
-                                                   std::vector<xla::Shape*> argument_layouts,
-                                                   xla::ExecutableBuildOptions& options,
-                                                   bool compile_portable_executable) {
+xla::StatusOr<std::vector<ExlaBuffer*>> ExlaClient::BuffersFromBinaries(ErlNifEnv* env,
+                                                                        ERL_NIF_TERM data_and_shapes,
+                                                                        int device_id) {
+  std::vector<ExlaBuffer*> buffers;
+  auto release_buffers = [&buffers]() {
+    for (auto buffer : buffers) delete buffer;
+  };
+
+  ERL_NIF_TERM head, tail;
+  while (enif_get_list_cell(env, data_and_shapes, &head, &tail)) {
+    const ERL_NIF_TERM* tuple;
+    int arity;
+    xla::Shape* shape;
+
+    if (!enif_get_tuple(env, head, &arity, &tuple) || arity != 2 ||
+        !enif_is_binary(env, tuple[0]) ||
+        !nif::get<xla::Shape>(env, tuple[1], shape)) {
+      release_buffers();
+      return xla::InvalidArgument("Expected a list of {binary, shape} tuples.");
+    }
+
+    auto statusor = BufferFromBinary(env, tuple[0], *shape, device_id, false);
+
+    if (!statusor.ok()) {
+      release_buffers();
+      return statusor.status();
+    }
+
+    buffers.push_back(statusor.ValueOrDie());
+    data_and_shapes = tail;
+  }
+
+  // All transfers are in flight, so this waits for the slowest one
+  for (auto buffer : buffers) {
+    xla::Status status = buffer->BlockHostUntilReady();
+
+    if (!status.ok()) {
+      release_buffers();
+      return status;
+    }
+  }
+
+  return buffers;
+}
+
+xla::CompileOptions MakeCompileOptions(std::vector<xla::Shape*> argument_layouts,
+                                       xla::ExecutableBuildOptions& options,
+                                       bool compile_portable_executable) {
   std::vector<xla::Shape> layouts;
   layouts.reserve(argument_layouts.size());
   for (auto shape : argument_layouts) {
@@ -199,6 +836,14 @@ xla::StatusOr<ExlaExecutable*> ExlaClient::Compile(const xla::XlaComputation& co
   compile_opts.parameter_is_tupled_arguments = false;
   compile_opts.executable_build_options = options;
   compile_opts.compile_portable_executable = compile_portable_executable;
+  return compile_opts;
+}
+
+xla::StatusOr<ExlaExecutable*> ExlaClient::Compile(const xla::XlaComputation& computation,
+                                                   std::vector<xla::Shape*> argument_layouts,
+                                                   xla::ExecutableBuildOptions& options,
+                                                   bool compile_portable_executable) {
+  xla::CompileOptions compile_opts = MakeCompileOptions(argument_layouts, options, compile_portable_executable);
 
   EXLA_ASSIGN_OR_RETURN(std::unique_ptr<xla::PjRtExecutable> executable,
     client_->Compile(computation, std::move(compile_opts)));
@@ -208,6 +853,59 @@ xla::StatusOr<ExlaExecutable*> ExlaClient::Compile(const xla::XlaComputation& co
   return new ExlaExecutable(std::move(executable), std::move(fingerprint), this);
 }
 
+xla::StatusOr<std::string> ExlaClient::SerializeExecutable(ExlaExecutable* executable) {
+  return client_->SerializeExecutable(*executable->executable());
+}
+
+xla::StatusOr<ExlaExecutable*> ExlaClient::DeserializeExecutable(const std::string& serialized,
+                                                                 std::vector<xla::Shape*> argument_layouts,
+                                                                 xla::ExecutableBuildOptions& options,
+                                                                 bool compile_portable_executable) {
+  xla::CompileOptions compile_opts = MakeCompileOptions(argument_layouts, options, compile_portable_executable);
+
+  EXLA_ASSIGN_OR_RETURN(std::unique_ptr<xla::PjRtExecutable> executable,
+    client_->DeserializeExecutable(serialized, nullptr, std::move(compile_opts)));
+  EXLA_ASSIGN_OR_RETURN(absl::optional<std::string> fingerprint,
+    client_->ExecutableFingerprint(*executable));
+
+  return new ExlaExecutable(std::move(executable), std::move(fingerprint), this);
+}
+
+void ExlaClient::CompileAsync(ErlNifPid pid,
+                              ErlNifEnv* msg_env,
+                              ERL_NIF_TERM ref,
+                              xla::XlaComputation computation,
+                              std::vector<xla::Shape> argument_layouts,
+                              xla::ExecutableBuildOptions options,
+                              bool compile_portable_executable) {
+  // ThreadPool::Schedule requires a copyable closure, so move-only
+  // state is shared with the worker instead
+  auto shared_computation = std::make_shared<xla::XlaComputation>(std::move(computation));
+  auto shared_layouts = std::make_shared<std::vector<xla::Shape>>(std::move(argument_layouts));
+
+  compile_thread_pool_->Schedule([this, pid, msg_env, ref, shared_computation, shared_layouts, options, compile_portable_executable]() mutable {
+    std::vector<xla::Shape*> layouts;
+    layouts.reserve(shared_layouts->size());
+    for (auto& shape : *shared_layouts) {
+      layouts.push_back(&shape);
+    }
+
+    ERL_NIF_TERM result;
+    auto statusor = Compile(*shared_computation, layouts, options, compile_portable_executable);
+
+    if (statusor.ok()) {
+      ExlaExecutable* executable = statusor.ValueOrDie();
+      result = nif::ok(msg_env, nif::make<ExlaExecutable*>(msg_env, executable));
+    } else {
+      result = nif::error(msg_env, statusor.status().error_message().c_str());
+    }
+
+    ErlNifPid to = pid;
+    enif_send(NULL, &to, msg_env, enif_make_tuple2(msg_env, ref, result));
+    enif_free_env(msg_env);
+  });
+}
+
 xla::Status ExlaClient::TransferToInfeed(ErlNifEnv* env,
                                          ERL_NIF_TERM data,
                                          const xla::Shape& shape,
@@ -281,6 +979,47 @@ xla::StatusOr<ERL_NIF_TERM> ExlaClient::TransferFromOutfeed(ErlNifEnv* env, int
   return nif::make(env, binary);
 }
 
+xla::StatusOr<ERL_NIF_TERM> ExlaClient::MemoryStats(ErlNifEnv* env, int device_id) {
+  EXLA_ASSIGN_OR_RETURN(xla::PjRtDevice* device, client_->LookupDevice(device_id));
+  ExlaMemoryStats stats = GetMemoryStats(device);
+
+  std::vector<std::pair<const char*, exla::int64>> entries = {
+    {"allocated_bytes", stats.allocated_bytes},
+    {"peak_allocated_bytes", stats.peak_allocated_bytes},
+    {"live_buffers", stats.live_buffers},
+    {"total_allocations", stats.total_allocations},
+    {"total_allocated_bytes", stats.total_allocated_bytes},
+    {"spilled_bytes", stats.spilled_bytes},
+    {"spilled_buffers", stats.spilled_buffers},
+    {"total_spills", stats.total_spills},
+    {"memory_budget", stats.memory_budget}
+  };
+
+  // Only stream executor devices with their own memory, such as
+  // GPUs, report usage. Host devices use the process memory.
+  auto se_device = dynamic_cast<xla::PjRtStreamExecutorDevice*>(device);
+  if (se_device != nullptr && !IsHostPlatform() && se_device->local_device_state() != nullptr) {
+    exla::int64 free_bytes, total_bytes;
+    if (se_device->local_device_state()->executor()->DeviceMemoryUsage(&free_bytes, &total_bytes)) {
+      entries.push_back({"device_free_bytes", free_bytes});
+      entries.push_back({"device_total_bytes", total_bytes});
+    }
+  }
+
+  ERL_NIF_TERM map = enif_make_new_map(env);
+  for (auto& entry : entries) {
+    enif_make_map_put(env, map, enif_make_atom(env, entry.first), enif_make_int64(env, entry.second), &map);
+  }
+
+  return map;
+}
+
+void ExlaClient::SetMemoryBudget(exla::int64 bytes) {
+  for (xla::PjRtDevice* device : client_->addressable_devices()) {
+    exla::SetMemoryBudget(device, bytes);
+  }
+}
+
 xla::StatusOr<ExlaClient*> GetHostClient() {
   EXLA_ASSIGN_OR_RETURN(std::unique_ptr<xla::PjRtClient> client,
     xla::GetCpuClient(false));
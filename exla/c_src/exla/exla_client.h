@@ -1,13 +1,17 @@
 #ifndef EXLA_CLIENT_H_
 #define EXLA_CLIENT_H_
 
+#include <list>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <vector>
 #include <utility>
 
 #include "exla_nif_util.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/threadpool.h"
 #include "tensorflow/compiler/xla/pjrt/pjrt_client.h"
 #include "tensorflow/compiler/xla/pjrt/gpu_device.h"
 
@@ -20,20 +24,96 @@ namespace exla {
 
 class ExlaClient;
 
+// A hold on device memory which is kept alive by a resource binary,
+// so host buffers can be read by the VM without copying them. PjRt
+// buffers must outlive the holds on their memory, so the reference
+// shares ownership of the buffer.
+struct ExlaExternalReference {
+  std::shared_ptr<xla::PjRtBuffer> buffer;
+  // Declared last, so the hold is dropped before the buffer
+  std::unique_ptr<xla::PjRtBuffer::ExternalReference> reference;
+};
+
+// Device memory held by live ExlaBuffers on a device. Buffers are
+// counted from creation until they are deallocated or collected.
+// Totals are cumulative, so allocation rates can be derived by
+// sampling them. Spilled buffers are counted apart, as they hold
+// host memory instead.
+struct ExlaMemoryStats {
+  exla::int64 allocated_bytes = 0;
+  exla::int64 peak_allocated_bytes = 0;
+  exla::int64 live_buffers = 0;
+  exla::int64 total_allocations = 0;
+  exla::int64 total_allocated_bytes = 0;
+  exla::int64 spilled_bytes = 0;
+  exla::int64 spilled_buffers = 0;
+  exla::int64 total_spills = 0;
+  exla::int64 memory_budget = 0;
+};
+
+ExlaMemoryStats GetMemoryStats(xla::PjRtDevice* device);
+
+// Sets how many bytes buffers may hold on `device` before the least
+// recently used ones are spilled to host literals, which is done by a
+// dedicated thread. They are moved back to the device once used again.
+// Zero disables the budget.
+void SetMemoryBudget(xla::PjRtDevice* device, exla::int64 bytes);
+
 class ExlaBuffer {
  public:
   ExlaBuffer(std::unique_ptr<xla::PjRtBuffer> buffer,
-             bool can_be_released_after_run_ = false);
+             bool can_be_released_after_run_ = false,
+             bool aliases_binary = false);
+
+  ~ExlaBuffer();
 
   bool release_after_run() { return can_be_released_after_run_; }
+  // Whether the device memory is the memory of an immutable binary
+  bool aliases_binary() { return aliases_binary_; }
+  // The underlying buffer, which is deleted while the buffer is
+  // spilled. Use Pin() to access buffers which may be spilled.
   xla::PjRtBuffer* buffer() { return buffer_.get(); }
-  xla::StatusOr<ERL_NIF_TERM> ToBinary(ErlNifEnv* env, exla::int64 size);
+  // Moves a spilled buffer back to the device and keeps it there until
+  // Unpin() is called. Pinning marks the buffer as the most recently used.
+  xla::StatusOr<xla::PjRtBuffer*> Pin();
+  void Unpin();
+  // Reads `size` bytes starting at `offset` into a binary, transferring
+  // only the requested range whenever the platform allows it. A negative
+  // size reads until the end of the buffer.
+  xla::StatusOr<ERL_NIF_TERM> ToBinary(ErlNifEnv* env, exla::int64 offset, exla::int64 size);
   xla::Status BlockHostUntilReady();
   xla::Status Deallocate();
 
  private:
-  std::unique_ptr<xla::PjRtBuffer> buffer_;
+  friend void SpillDeviceLocked(xla::PjRtDevice* device, std::unique_lock<std::mutex>& lock);
+
+  // The methods below must be called with the memory lock held.
+  // Spilling and restoring release the lock while data is copied.
+  xla::Status SpillLocked(std::unique_lock<std::mutex>& lock);
+  xla::Status RestoreLocked(std::unique_lock<std::mutex>& lock);
+  void ReleaseLocked();
+
+  // Shared with the binaries pointing to the buffer memory
+  std::shared_ptr<xla::PjRtBuffer> buffer_;
   bool can_be_released_after_run_;
+  bool aliases_binary_;
+  xla::PjRtDevice* device_;
+  exla::int64 bytes_;
+  // The fields below are guarded by the memory lock
+  bool released_ = false;
+  int pins_ = 0;
+  std::shared_ptr<xla::Literal> spilled_;
+  // Whether a pin is copying the spilled buffer back to the device
+  bool restoring_ = false;
+  // Position in the device list of buffers which may be spilled
+  bool spillable_ = false;
+  std::list<ExlaBuffer*>::iterator lru_position_;
+};
+
+// The outputs of a replica and the device it ran on
+struct ExlaReplicaResult {
+  std::vector<std::unique_ptr<xla::PjRtBuffer>> buffers;
+  int device_id;
 };
 
 class ExlaExecutable {
@@ -44,14 +124,38 @@ class ExlaExecutable {
 
   xla::PjRtExecutable* executable() { return executable_.get(); }
 
-  xla::StatusOr<ERL_NIF_TERM> Run(ErlNifEnv* env,
-                                  ERL_NIF_TERM arguments,
-                                  bool keep_on_device,
-                                  int device_id);
+  // Parameters aliased to an output. PjRt donates their buffers on
+  // run, which deletes them once the execution is enqueued.
+  const std::set<exla::int64>& donated_parameters() { return donated_parameters_; }
+
+  // An estimate of the host or device memory held by the compiled
+  // code, which is freed once the executable resource is collected.
+  exla::int64 size_bytes() { return size_bytes_; }
+
+  // Runs the executable and sends `{ref, {:ok, result} | {:error, msg}}`
+  // to `pid` once all outputs are ready. The execution is enqueued by the
+  // caller and a thread of the read pool waits for and sends the result.
+  // Takes ownership of `msg_env`, which must hold `ref`, `arguments` and
+  // a reference to this executable's resource, so everything used by the
+  // execution is kept alive until it is done.
+  void RunAsync(ErlNifPid pid,
+                ErlNifEnv* msg_env,
+                ERL_NIF_TERM ref,
+                ERL_NIF_TERM arguments,
+                bool keep_on_device,
+                int device_id);
 
  private:
+  // Prepares the arguments and enqueues the execution, returning
+  // the outputs of each replica, which may not be ready yet
+  xla::StatusOr<std::vector<ExlaReplicaResult>> Execute(ErlNifEnv* env,
+                                                        ERL_NIF_TERM arguments,
+                                                        int device_id);
+
   std::unique_ptr<xla::PjRtExecutable> executable_;
   absl::optional<std::string> fingerprint_;
+  std::set<exla::int64> donated_parameters_;
+  exla::int64 size_bytes_ = 0;
   ExlaClient* client_;
 };
 
@@ -63,16 +167,58 @@ class ExlaClient {
 
   xla::PjRtClient* client() { return client_.get(); }
 
+  tensorflow::thread::ThreadPool* read_thread_pool() { return read_thread_pool_.get(); }
+
   // Compiles the given computation with the given compile options
   xla::StatusOr<ExlaExecutable*> Compile(const xla::XlaComputation&,
                                          std::vector<xla::Shape*> argument_layouts,
                                          xla::ExecutableBuildOptions& options,
                                          bool compile_portable_executable);
 
-  xla::StatusOr<ExlaBuffer*> BufferFromBinary(const ErlNifBinary& binary,
+  // Serializes the executable so it can be persisted across restarts.
+  // Returns an error on platforms which do not support serialization.
+  xla::StatusOr<std::string> SerializeExecutable(ExlaExecutable* executable);
+
+  // Loads an executable previously returned by SerializeExecutable,
+  // given the same options it was compiled with.
+  xla::StatusOr<ExlaExecutable*> DeserializeExecutable(const std::string& serialized,
+                                                       std::vector<xla::Shape*> argument_layouts,
+                                                       xla::ExecutableBuildOptions& options,
+                                                       bool compile_portable_executable);
+
+  // Compiles the given computation on the client compile thread pool,
+  // so compilation never blocks a scheduler. Once compilation finishes,
+  // `{ref, {:ok, executable} | {:error, msg}}` is sent to `pid`. Takes
+  // ownership of `msg_env`, which must hold `ref`.
+  void CompileAsync(ErlNifPid pid,
+                    ErlNifEnv* msg_env,
+                    ERL_NIF_TERM ref,
+                    xla::XlaComputation computation,
+                    std::vector<xla::Shape> argument_layouts,
+                    xla::ExecutableBuildOptions options,
+                    bool compile_portable_executable);
+
+  // Transfers the binary `source_term` to the given device. On the host
+  // platform, the buffer aliases the binary memory instead of copying it
+  // and the binary is kept alive for as long as the buffer needs it.
+  // Buffers which will be donated must set `zero_copy` to false, as
+  // binaries are immutable.
+  xla::StatusOr<ExlaBuffer*> BufferFromBinary(ErlNifEnv* env,
+                                              ERL_NIF_TERM source_term,
                                               xla::Shape& shape,
                                               int device_id,
-                                              bool can_be_released_after_run);
+                                              bool can_be_released_after_run,
+                                              bool zero_copy = true);
+
+  // Transfers all `{binary, shape}` pairs in the given list to the
+  // device. All transfers are started before waiting on any of them,
+  // so they happen concurrently.
+  xla::StatusOr<std::vector<ExlaBuffer*>> BuffersFromBinaries(ErlNifEnv* env,
+                                                              ERL_NIF_TERM data_and_shapes,
+                                                              int device_id);
+
+  // Whether device memory is the process memory
+  bool IsHostPlatform() { return client_->platform_name() == "cpu"; }
 
   // TODO(seanmor5): This is device logic and should be refactored
   xla::Status TransferToInfeed(ErlNifEnv* env,
@@ -82,8 +228,21 @@ class ExlaClient {
 
   xla::StatusOr<ERL_NIF_TERM> TransferFromOutfeed(ErlNifEnv* env, int device_id, xla::Shape& shape);
 
+  // Returns a map with the ExlaMemoryStats of the given device and,
+  // where the platform reports them, its free and total memory.
+  xla::StatusOr<ERL_NIF_TERM> MemoryStats(ErlNifEnv* env, int device_id);
+
+  // Sets the memory budget of all addressable devices
+  void SetMemoryBudget(exla::int64 bytes);
+
  private:
   std::shared_ptr<xla::PjRtClient> client_;
+  // Threads dedicated to compilation, which can take seconds for
+  // large graphs and therefore must not run on VM schedulers
+  std::unique_ptr<tensorflow::thread::ThreadPool> compile_thread_pool_;
+  // Threads which read the outputs of asynchronous executions to
+  // binaries once they are ready, as that may copy from the device
+  std::unique_ptr<tensorflow::thread::ThreadPool> read_thread_pool_;
 };
 
 xla::StatusOr<ExlaClient*> GetHostClient();
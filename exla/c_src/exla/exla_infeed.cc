@@ -0,0 +1,143 @@
+#include "exla_infeed.h"
+
+#include <thread>
+
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace exla {
+
+ExlaInfeedQueue::ExlaInfeedQueue(xla::PjRtDevice* device, int depth) : device_(device),
+                                                                       depth_(depth) {}
+
+ExlaInfeedQueue::~ExlaInfeedQueue() {
+  for (Entry& entry : queue_) {
+    enif_free_env(entry.env);
+  }
+}
+
+void ExlaInfeedQueue::Start() {
+  // The thread keeps the queue alive until all entries are transferred
+  auto self = shared_from_this();
+  std::thread([self] { self->FeedLoop(); }).detach();
+}
+
+void ExlaInfeedQueue::Close() {
+  std::lock_guard<std::mutex> lock(mu_);
+  closed_ = true;
+  cv_.notify_all();
+}
+
+xla::Status ExlaInfeedQueue::Push(ErlNifEnv* env, ERL_NIF_TERM data) {
+  // Large binaries are reference counted, so copying
+  // them to the entry env does not copy their contents
+  Entry entry;
+  entry.env = enif_alloc_env();
+  ERL_NIF_TERM list = enif_make_copy(entry.env, data);
+
+  ERL_NIF_TERM head, tail;
+  while (enif_get_list_cell(entry.env, list, &head, &tail)) {
+    const ERL_NIF_TERM* terms;
+    int count;
+    xla::Shape* shape;
+    Item item;
+
+    if (!enif_get_tuple(entry.env, head, &count, &terms) || count != 2 ||
+        !nif::get<xla::Shape>(entry.env, terms[1], shape)) {
+      enif_free_env(entry.env);
+      return xla::InvalidArgument("infeed operation expects a list of binary-shape tuples");
+    }
+
+    ERL_NIF_TERM binaries = terms[0];
+    ERL_NIF_TERM binary_head, binary_tail;
+    ErlNifBinary binary;
+
+    if (nif::get_binary(entry.env, binaries, &binary)) {
+      item.buffers.push_back(reinterpret_cast<const char*>(binary.data));
+    } else {
+      while (enif_get_list_cell(entry.env, binaries, &binary_head, &binary_tail)) {
+        if (!nif::get_binary(entry.env, binary_head, &binary)) {
+          enif_free_env(entry.env);
+          return xla::InvalidArgument("infeed operation expects a list of binaries");
+        }
+        item.buffers.push_back(reinterpret_cast<const char*>(binary.data));
+        binaries = binary_tail;
+      }
+    }
+
+    if (xla::ShapeUtil::IsNestedTuple(*shape)) {
+      enif_free_env(entry.env);
+      return xla::InvalidArgument("nested tuples are not supported in infeed operation");
+    }
+    if (item.buffers.empty()) {
+      enif_free_env(entry.env);
+      return xla::InvalidArgument("infeed operation expects a list of binaries");
+    }
+
+    item.shape = *shape;
+    entry.items.push_back(std::move(item));
+    list = tail;
+  }
+
+  std::unique_lock<std::mutex> lock(mu_);
+  cv_.wait(lock, [this] {
+    return !status_.ok() || queue_.size() + (in_flight_ ? 1 : 0) < depth_;
+  });
+
+  if (!status_.ok()) {
+    enif_free_env(entry.env);
+    return status_;
+  }
+
+  queue_.push_back(std::move(entry));
+  cv_.notify_all();
+  return xla::Status::OK();
+}
+
+xla::Status ExlaInfeedQueue::Transfer(const Entry& entry) {
+  for (const Item& item : entry.items) {
+    if (item.shape.IsTuple()) {
+      xla::BorrowingLiteral literal(item.buffers, item.shape);
+      EXLA_EFFECT_OR_RETURN(device_->TransferToInfeed(literal));
+    } else {
+      xla::BorrowingLiteral literal(item.buffers[0], item.shape);
+      EXLA_EFFECT_OR_RETURN(device_->TransferToInfeed(literal));
+    }
+  }
+
+  return xla::Status::OK();
+}
+
+void ExlaInfeedQueue::FeedLoop() {
+  while (true) {
+    Entry entry;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      cv_.wait(lock, [this] { return closed_ || !queue_.empty(); });
+
+      if (queue_.empty()) return;
+
+      entry = std::move(queue_.front());
+      queue_.pop_front();
+      in_flight_ = true;
+    }
+
+    xla::Status status = Transfer(entry);
+    enif_free_env(entry.env);
+
+    std::lock_guard<std::mutex> lock(mu_);
+    in_flight_ = false;
+
+    if (!status.ok()) {
+      // Entries queued after a failed transfer are never fed
+      status_ = status;
+      for (Entry& pending : queue_) {
+        enif_free_env(pending.env);
+      }
+      queue_.clear();
+    }
+
+    cv_.notify_all();
+  }
+}
+
+}  // namespace exla
@@ -0,0 +1,70 @@
+#ifndef EXLA_INFEED_H_
+#define EXLA_INFEED_H_
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "exla_nif_util.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/pjrt/pjrt_client.h"
+
+namespace exla {
+
+// Feeds the infeed of a device from a dedicated thread, so callers
+// return as soon as their data is queued and the host can prepare
+// the next entry while the device computes on the current one.
+//
+// Each entry is a list of `{binary | [binary], shape}` tuples, which
+// are transferred in order. Binaries are referenced from a private
+// env and borrowed by the literals, so they are not copied. Pushing
+// blocks while `depth` entries, including the one being transferred,
+// are pending. Once a transfer fails, all further pushes fail.
+class ExlaInfeedQueue : public std::enable_shared_from_this<ExlaInfeedQueue> {
+ public:
+  ExlaInfeedQueue(xla::PjRtDevice* device, int depth);
+
+  ~ExlaInfeedQueue();
+
+  // Starts the feeder thread
+  void Start();
+
+  // Queues the given list of binary-shape tuples, blocking while
+  // the queue is full
+  xla::Status Push(ErlNifEnv* env, ERL_NIF_TERM data);
+
+  // Stops the feeder thread once all queued entries are transferred
+  void Close();
+
+ private:
+  struct Item {
+    std::vector<const char*> buffers;
+    xla::Shape shape;
+  };
+
+  struct Entry {
+    ErlNifEnv* env = nullptr;
+    std::vector<Item> items;
+  };
+
+  void FeedLoop();
+  xla::Status Transfer(const Entry& entry);
+
+  xla::PjRtDevice* device_;
+  size_t depth_;
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<Entry> queue_;
+  bool in_flight_ = false;
+  bool closed_ = false;
+  xla::Status status_;
+};
+
+using ExlaInfeedQueueRef = std::shared_ptr<ExlaInfeedQueue>;
+
+}  // namespace exla
+
+#endif
@@ -441,6 +441,65 @@ namespace nif {
     return 1;
   }
 
+  int get_replica_groups(ErlNifEnv* env,
+                         ERL_NIF_TERM list,
+                         std::vector<xla::ReplicaGroup>& replica_groups) {
+    if (!enif_is_list(env, list)) return 0;
+
+    ERL_NIF_TERM group, tail;
+    while (enif_get_list_cell(env, list, &group, &tail)) {
+      std::vector<int64> replica_ids;
+      if (!get_list(env, group, replica_ids)) return 0;
+
+      xla::ReplicaGroup replica_group;
+      for (int64 replica_id : replica_ids) {
+        replica_group.add_replica_ids(replica_id);
+      }
+      replica_groups.push_back(replica_group);
+
+      list = tail;
+    }
+    // Improper lists end with a term which is not a list
+    return enif_is_empty_list(env, list);
+  }
+
+  int get_source_target_pairs(ErlNifEnv* env,
+                              ERL_NIF_TERM list,
+                              std::vector<std::pair<int64, int64>>& pairs) {
+    // Pairs have the same representation as a general padding
+    return get_general_padding(env, list, pairs);
+  }
+
+  int get_op_sharding(ErlNifEnv* env,
+                      ERL_NIF_TERM term,
+                      xla::OpSharding* sharding) {
+    std::string atom;
+    if (get_atom(env, term, &atom)) {
+      if (atom != "replicated") return 0;
+      sharding->set_type(xla::OpSharding::REPLICATED);
+      return 1;
+    }
+
+    const ERL_NIF_TERM* terms;
+    int count;
+    if (!enif_get_tuple(env, term, &count, &terms)) return 0;
+    if (count != 2) return 0;
+
+    std::vector<int64> tile_dimensions;
+    std::vector<int64> devices;
+    if (!get_tuple(env, terms[0], tile_dimensions)) return 0;
+    if (!get_list(env, terms[1], devices)) return 0;
+
+    sharding->set_type(xla::OpSharding::OTHER);
+    for (int64 dimension : tile_dimensions) {
+      sharding->add_tile_assignment_dimensions(dimension);
+    }
+    for (int64 device : devices) {
+      sharding->add_tile_assignment_devices(device);
+    }
+    return 1;
+  }
+
   int get_primitive_type(ErlNifEnv* env, ERL_NIF_TERM term, xla::PrimitiveType* type) {
     std::string type_str;
     if (!get(env, term, type_str)) return 0;
@@ -307,6 +307,27 @@ int get_general_padding(ErlNifEnv* env,
                         ERL_NIF_TERM padding_term,
                         std::vector<std::pair<int64, int64>>& padding);
 
+// Gets replica groups for usage in collective operations. We receive
+// the replica groups as a list of lists of replica ids. An empty list
+// means all replicas form a single group.
+int get_replica_groups(ErlNifEnv* env,
+                       ERL_NIF_TERM list,
+                       std::vector<xla::ReplicaGroup>& replica_groups);
+
+// Gets the source/target pairs of a collective permute from a list
+// of 2-tuples of replica ids.
+int get_source_target_pairs(ErlNifEnv* env,
+                            ERL_NIF_TERM list,
+                            std::vector<std::pair<int64, int64>>& pairs);
+
+// Gets a sharding annotation. We receive either the atom `replicated`
+// or a 2-tuple with the tile assignment dimensions, one per dimension
+// of the sharded shape, and the list of devices each tile is assigned
+// to, in row-major order.
+int get_op_sharding(ErlNifEnv* env,
+                    ERL_NIF_TERM term,
+                    xla::OpSharding* sharding);
+
 // Gets the primitive type from the given term. The term is a string
 // encoding one of the XLA primitive types.
 int get_primitive_type(ErlNifEnv* env, ERL_NIF_TERM term, xla::PrimitiveType* type);
@@ -0,0 +1,176 @@
+#include "exla_outfeed.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace exla {
+
+ExlaOutfeedReader::ExlaOutfeedReader(xla::PjRtDevice* device,
+                                     std::map<uint16, std::vector<xla::Shape>> hooks,
+                                     ErlNifPid pid,
+                                     ERL_NIF_TERM ref,
+                                     int capacity,
+                                     int max_batch) : device_(device),
+                                                      hooks_(std::move(hooks)),
+                                                      pid_(pid),
+                                                      max_batch_(max_batch),
+                                                      ring_(capacity) {
+  ref_env_ = enif_alloc_env();
+  ref_ = enif_make_copy(ref_env_, ref);
+}
+
+ExlaOutfeedReader::~ExlaOutfeedReader() {
+  enif_free_env(ref_env_);
+}
+
+void ExlaOutfeedReader::Start() {
+  // Both threads keep the reader alive until they are done,
+  // even if the resource is garbage collected before
+  auto self = shared_from_this();
+  std::thread([self] { self->ReadLoop(); }).detach();
+  std::thread([self] { self->SendLoop(); }).detach();
+}
+
+void ExlaOutfeedReader::Ack() {
+  std::lock_guard<std::mutex> lock(mu_);
+  in_flight_ = false;
+  cv_.notify_all();
+}
+
+void ExlaOutfeedReader::Close() {
+  std::lock_guard<std::mutex> lock(mu_);
+  closed_ = true;
+  cv_.notify_all();
+}
+
+void ExlaOutfeedReader::Finish(xla::Status status) {
+  std::lock_guard<std::mutex> lock(mu_);
+  done_ = true;
+  status_ = status;
+  cv_.notify_all();
+}
+
+xla::Status ExlaOutfeedReader::ReadMessage(uint16 flag,
+                                           const std::vector<xla::Shape>& shapes,
+                                           Slot& slot) {
+  slot.flag = flag;
+  slot.literals.resize(shapes.size());
+
+  for (size_t i = 0; i < shapes.size(); i++) {
+    // Literals are only allocated when the slot last held another shape
+    if (!xla::ShapeUtil::Equal(slot.literals[i].shape(), shapes[i])) {
+      slot.literals[i] = xla::Literal(shapes[i]);
+    }
+
+    EXLA_EFFECT_OR_RETURN(device_->TransferFromOutfeed(&slot.literals[i]));
+  }
+
+  return xla::Status::OK();
+}
+
+void ExlaOutfeedReader::ReadLoop() {
+  xla::Literal flag_literal(xla::ShapeUtil::MakeShape(xla::U16, {}));
+  // Messages read after the consumer is gone are discarded here
+  Slot discarded;
+
+  while (true) {
+    xla::Status status = device_->TransferFromOutfeed(&flag_literal);
+    if (!status.ok()) return Finish(status);
+
+    uint16 flag = flag_literal.Get<uint16>({});
+    if (flag == 0) return Finish(xla::Status::OK());
+
+    auto hook = hooks_.find(flag);
+    if (hook == hooks_.end()) {
+      return Finish(xla::InvalidArgument("Unknown outfeed flag %d.", flag));
+    }
+
+    Slot* slot;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      cv_.wait(lock, [this] { return closed_ || size_ < ring_.size(); });
+      slot = closed_ ? &discarded : &ring_[(head_ + size_) % ring_.size()];
+    }
+
+    status = ReadMessage(flag, hook->second, *slot);
+    if (!status.ok()) return Finish(status);
+
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      if (slot != &discarded) {
+        size_++;
+        cv_.notify_all();
+      }
+    }
+  }
+}
+
+void ExlaOutfeedReader::SendLoop() {
+  ErlNifEnv* env = enif_alloc_env();
+
+  while (true) {
+    size_t first, count;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      cv_.wait(lock, [this] {
+        return closed_ || (size_ > 0 && !in_flight_) || (done_ && size_ == 0);
+      });
+
+      if (closed_) break;
+
+      if (size_ == 0) {
+        ERL_NIF_TERM result;
+        if (status_.ok()) {
+          result = enif_make_atom(env, "done");
+        } else {
+          result = nif::error(env, status_.error_message().c_str());
+        }
+        enif_send(NULL, &pid_, env, enif_make_tuple2(env, enif_make_copy(env, ref_), result));
+        break;
+      }
+
+      first = head_;
+      count = std::min(size_, static_cast<size_t>(max_batch_));
+      in_flight_ = true;
+    }
+
+    // The slots being sent are not touched by the reader until
+    // they are released below, so we can copy them without a lock
+    std::vector<ERL_NIF_TERM> messages;
+    for (size_t i = 0; i < count; i++) {
+      Slot& slot = ring_[(first + i) % ring_.size()];
+      std::vector<ERL_NIF_TERM> binaries;
+
+      for (xla::Literal& literal : slot.literals) {
+        ErlNifBinary binary;
+        enif_alloc_binary(literal.size_bytes(), &binary);
+        std::memcpy(binary.data, literal.untyped_data(), literal.size_bytes());
+        binaries.push_back(nif::make(env, binary));
+      }
+
+      ERL_NIF_TERM list = enif_make_list_from_array(env, binaries.data(), binaries.size());
+      messages.push_back(enif_make_tuple2(env, enif_make_uint(env, slot.flag), list));
+    }
+
+    ERL_NIF_TERM batch = enif_make_tuple2(env,
+      enif_make_atom(env, "outfeed"),
+      enif_make_list_from_array(env, messages.data(), messages.size()));
+
+    bool sent = enif_send(NULL, &pid_, env, enif_make_tuple2(env, enif_make_copy(env, ref_), batch));
+    enif_clear_env(env);
+
+    std::lock_guard<std::mutex> lock(mu_);
+    head_ = (head_ + count) % ring_.size();
+    size_ -= count;
+    // If the consumer is gone, we stop sending but let the reader drain
+    if (!sent) closed_ = true;
+    cv_.notify_all();
+  }
+
+  enif_free_env(env);
+}
+
+}  // namespace exla
@@ -0,0 +1,87 @@
+#ifndef EXLA_OUTFEED_H_
+#define EXLA_OUTFEED_H_
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "exla_nif_util.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/pjrt/pjrt_client.h"
+
+namespace exla {
+
+// Reads the outfeed of a device on dedicated threads, so long running
+// computations, such as streams, do not hold a dirty IO scheduler.
+//
+// The computation outfeeds a u16 flag followed by the tensors of the
+// hook identified by the flag, and a 0 flag once it is done. A reader
+// thread reads messages into a bounded ring of slots, whose literals
+// are reused across messages, while a sender thread delivers all
+// pending messages to `pid` in a single message:
+//
+//     {ref, {:outfeed, [{flag, [binary]}]}}
+//
+// The consumer must call Ack() once it has processed each batch. Only
+// one batch is in flight at a time, so once the consumer falls behind,
+// the ring fills up and the reader stops reading, which blocks the
+// computation on outfeed. Once the 0 flag is read and all batches are
+// delivered, `{ref, :done}` or `{ref, {:error, msg}}` is sent.
+class ExlaOutfeedReader : public std::enable_shared_from_this<ExlaOutfeedReader> {
+ public:
+  ExlaOutfeedReader(xla::PjRtDevice* device,
+                    std::map<uint16, std::vector<xla::Shape>> hooks,
+                    ErlNifPid pid,
+                    ERL_NIF_TERM ref,
+                    int capacity,
+                    int max_batch);
+
+  ~ExlaOutfeedReader();
+
+  // Starts the reader and sender threads
+  void Start();
+
+  // Marks the oldest batch in flight as processed
+  void Ack();
+
+  // Stops delivering messages. The outfeed is still drained until the
+  // computation is done, otherwise it would block forever.
+  void Close();
+
+ private:
+  struct Slot {
+    uint16 flag;
+    std::vector<xla::Literal> literals;
+  };
+
+  void ReadLoop();
+  void SendLoop();
+  xla::Status ReadMessage(uint16 flag, const std::vector<xla::Shape>& shapes, Slot& slot);
+  void Finish(xla::Status status);
+
+  xla::PjRtDevice* device_;
+  std::map<uint16, std::vector<xla::Shape>> hooks_;
+  ErlNifPid pid_;
+  ErlNifEnv* ref_env_;
+  ERL_NIF_TERM ref_;
+  int max_batch_;
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::vector<Slot> ring_;
+  // Messages in [head_, head_ + size_) are read and not yet sent
+  size_t head_ = 0;
+  size_t size_ = 0;
+  bool in_flight_ = false;
+  bool done_ = false;
+  bool closed_ = false;
+  xla::Status status_;
+};
+
+using ExlaOutfeedReaderRef = std::shared_ptr<ExlaOutfeedReader>;
+
+}  // namespace exla
+
+#endif
@@ -0,0 +1,380 @@
+#include "exla_tape.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <utility>
+
+#include "exla_nif_util.h"
+#include "tensorflow/compiler/xla/client/lib/math.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace exla {
+
+namespace {
+
+// The layout of each instruction, in native endianness, is:
+//
+//     opcode::8, type::8, rank::8, dims::64*rank,
+//     operand_count::32, operands::32*operand_count,
+//     int_count::16, ints::64*int_count,
+//     byte_size::32, bytes
+//
+// Operands are indexes of previous instructions. Opcodes, types and
+// the unary/binary tables below must be kept in sync with EXLA.Defn.Tape.
+
+enum TapeOpcode : uint8_t {
+  kParameter = 0,
+  kConstant = 1,
+  kTensor = 2,
+  kTuple = 3,
+  kReshape = 4,
+  kBroadcast = 5,
+  kTranspose = 6,
+  kConvert = 7,
+  kSelect = 8,
+  kDot = 9,
+  kReduce = 10,
+  kUnary = 11,
+  kBinary = 12,
+};
+
+const xla::PrimitiveType kTypes[] = {
+  xla::PRED, xla::S8, xla::S16, xla::S32, xla::S64,
+  xla::U8, xla::U16, xla::U32, xla::U64,
+  xla::F16, xla::BF16, xla::F32, xla::F64, xla::C64, xla::C128
+};
+
+xla::XlaOp(*const kUnaryOps[])(xla::XlaOp) = {
+  xla::Abs, xla::Neg, xla::Exp, xla::Expm1, xla::Log, xla::Log1p,
+  xla::Logistic, xla::Cos, xla::Sin, xla::Tanh, xla::Sqrt, xla::Rsqrt,
+  xla::Cbrt, xla::Floor, xla::Ceil, xla::Round, xla::Not,
+  xla::PopulationCount, xla::Clz, xla::Acos, xla::Asin, xla::Atan,
+  xla::Cosh, xla::Sinh, xla::Acosh, xla::Asinh, xla::Atanh, xla::Erf,
+  xla::Erfc, xla::ErfInv
+};
+
+xla::XlaOp(*const kBinaryOps[])(xla::XlaOp, xla::XlaOp, absl::Span<const int64>) = {
+  xla::Add, xla::Sub, xla::Mul, xla::Div, xla::Rem, xla::Min, xla::Max,
+  xla::Pow, xla::Atan2, xla::And, xla::Or, xla::Xor, xla::ShiftLeft,
+  xla::ShiftRightLogical, xla::ShiftRightArithmetic, xla::Eq, xla::Ne,
+  xla::Gt, xla::Lt, xla::Ge, xla::Le
+};
+
+// Reducers, in the order of the first integer of reduce instructions
+xla::XlaOp(*const kReducers[])(xla::XlaOp, xla::XlaOp, absl::Span<const int64>) = {
+  xla::Add, xla::Mul, xla::Max, xla::Min
+};
+
+struct Instruction {
+  uint8 opcode;
+  xla::PrimitiveType type;
+  std::vector<int64> dims;
+  std::vector<xla::XlaOp> operands;
+  std::vector<int64> ints;
+  const unsigned char* bytes;
+  uint32 byte_size;
+};
+
+class TapeReader {
+ public:
+  TapeReader(const unsigned char* data, size_t size) : data_(data), size_(size), pos_(0) {}
+
+  bool done() { return pos_ == size_; }
+
+  template <typename T>
+  xla::StatusOr<T> Read() {
+    if (size_ - pos_ < sizeof(T)) {
+      return xla::InvalidArgument("Tape ended unexpectedly.");
+    }
+    T value;
+    std::memcpy(&value, data_ + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return value;
+  }
+
+  xla::StatusOr<const unsigned char*> ReadBytes(size_t count) {
+    if (size_ - pos_ < count) {
+      return xla::InvalidArgument("Tape ended unexpectedly.");
+    }
+    const unsigned char* bytes = data_ + pos_;
+    pos_ += count;
+    return bytes;
+  }
+
+ private:
+  const unsigned char* data_;
+  size_t size_;
+  size_t pos_;
+};
+
+xla::StatusOr<Instruction> ReadInstruction(TapeReader& reader,
+                                           const std::vector<xla::XlaOp>& ops) {
+  Instruction instruction;
+
+  EXLA_ASSIGN_OR_RETURN(instruction.opcode, reader.Read<uint8>());
+  EXLA_ASSIGN_OR_RETURN(uint8 type, reader.Read<uint8>());
+  if (type >= sizeof(kTypes) / sizeof(kTypes[0])) {
+    return xla::InvalidArgument("Invalid type in tape.");
+  }
+  instruction.type = kTypes[type];
+
+  EXLA_ASSIGN_OR_RETURN(uint8 rank, reader.Read<uint8>());
+  for (int i = 0; i < rank; i++) {
+    EXLA_ASSIGN_OR_RETURN(int64 dim, reader.Read<int64>());
+    instruction.dims.push_back(dim);
+  }
+
+  EXLA_ASSIGN_OR_RETURN(uint32 operand_count, reader.Read<uint32>());
+  for (uint32 i = 0; i < operand_count; i++) {
+    EXLA_ASSIGN_OR_RETURN(uint32 operand, reader.Read<uint32>());
+    if (operand >= ops.size()) {
+      return xla::InvalidArgument("Invalid operand in tape.");
+    }
+    instruction.operands.push_back(ops[operand]);
+  }
+
+  EXLA_ASSIGN_OR_RETURN(uint16 int_count, reader.Read<uint16>());
+  for (int i = 0; i < int_count; i++) {
+    EXLA_ASSIGN_OR_RETURN(int64 value, reader.Read<int64>());
+    instruction.ints.push_back(value);
+  }
+
+  EXLA_ASSIGN_OR_RETURN(instruction.byte_size, reader.Read<uint32>());
+  EXLA_ASSIGN_OR_RETURN(instruction.bytes, reader.ReadBytes(instruction.byte_size));
+
+  return instruction;
+}
+
+xla::StatusOr<xla::XlaOp> ToType(xla::XlaBuilder* builder,
+                                 xla::XlaOp op,
+                                 xla::PrimitiveType type) {
+  EXLA_ASSIGN_OR_RETURN(xla::Shape shape, builder->GetShape(op));
+  if (shape.element_type() == type) return op;
+  return xla::ConvertElementType(op, type);
+}
+
+// Broadcasts the lower rank operand to the trailing dimensions of the
+// higher rank one, as in Nx. Operands of the same rank are broadcast
+// by XLA along their degenerate dimensions.
+xla::StatusOr<std::vector<int64>> BroadcastDimensions(xla::XlaBuilder* builder,
+                                                      xla::XlaOp left,
+                                                      xla::XlaOp right) {
+  EXLA_ASSIGN_OR_RETURN(xla::Shape left_shape, builder->GetShape(left));
+  EXLA_ASSIGN_OR_RETURN(xla::Shape right_shape, builder->GetShape(right));
+  int64 left_rank = left_shape.rank();
+  int64 right_rank = right_shape.rank();
+  int64 min_rank = std::min(left_rank, right_rank);
+  int64 max_rank = std::max(left_rank, right_rank);
+
+  std::vector<int64> dims;
+  if (min_rank != max_rank) {
+    for (int64 i = max_rank - min_rank; i < max_rank; i++) dims.push_back(i);
+  }
+  return dims;
+}
+
+xla::StatusOr<xla::XlaOp> BroadcastTo(xla::XlaBuilder* builder,
+                                      xla::XlaOp op,
+                                      const std::vector<int64>& dims) {
+  EXLA_ASSIGN_OR_RETURN(xla::Shape shape, builder->GetShape(op));
+  int64 rank = dims.size();
+  std::vector<int64> broadcast_dims;
+  for (int64 i = rank - shape.rank(); i < rank; i++) broadcast_dims.push_back(i);
+  return xla::BroadcastInDim(op, dims, broadcast_dims);
+}
+
+xla::StatusOr<xla::XlaOp> Literal(xla::XlaBuilder* builder,
+                                  const Instruction& instruction,
+                                  const std::vector<int64>& dims) {
+  xla::Shape shape = xla::ShapeUtil::MakeShape(instruction.type, dims);
+  if (xla::ShapeUtil::ByteSizeOf(shape) != instruction.byte_size) {
+    return xla::InvalidArgument("Literal size does not match its shape in tape.");
+  }
+  const char* data = reinterpret_cast<const char*>(instruction.bytes);
+  xla::BorrowingLiteral literal(data, shape);
+  return xla::ConstantLiteral(builder, literal);
+}
+
+xla::StatusOr<xla::XlaOp> Reduce(xla::XlaBuilder* builder,
+                                 const Instruction& instruction,
+                                 std::map<std::pair<int64, xla::PrimitiveType>, xla::XlaComputation>& reducers) {
+  if (instruction.ints.size() < 2 || instruction.ints[0] < 0 || instruction.ints[0] > 3) {
+    return xla::InvalidArgument("Invalid reduce instruction in tape.");
+  }
+
+  int64 kind = instruction.ints[0];
+  bool keep_axes = instruction.ints[1];
+  std::vector<int64> axes(instruction.ints.begin() + 2, instruction.ints.end());
+
+  auto key = std::make_pair(kind, instruction.type);
+  auto reducer = reducers.find(key);
+  if (reducer == reducers.end()) {
+    std::unique_ptr<xla::XlaBuilder> sub_builder = builder->CreateSubBuilder("tape-reducer");
+    xla::Shape scalar = xla::ShapeUtil::MakeShape(instruction.type, {});
+    xla::XlaOp left = xla::Parameter(sub_builder.get(), 0, scalar, "p0");
+    xla::XlaOp right = xla::Parameter(sub_builder.get(), 1, scalar, "p1");
+    kReducers[kind](left, right, {});
+    EXLA_ASSIGN_OR_RETURN(xla::XlaComputation computation, sub_builder->Build());
+    reducer = reducers.emplace(key, std::move(computation)).first;
+  }
+
+  EXLA_ASSIGN_OR_RETURN(xla::XlaOp operand, ToType(builder, instruction.operands[0], instruction.type));
+  EXLA_ASSIGN_OR_RETURN(xla::XlaOp init_value, Literal(builder, instruction, {}));
+  xla::XlaOp op = xla::Reduce(operand, init_value, reducer->second, axes);
+  return keep_axes ? xla::Reshape(op, instruction.dims) : op;
+}
+
+xla::StatusOr<xla::XlaOp> Dot(xla::XlaBuilder* builder,
+                              const Instruction& instruction) {
+  // The integers are the precision followed by the contracting and
+  // batch dimensions of each side, each prefixed by their length.
+  const std::vector<int64>& ints = instruction.ints;
+  std::vector<int64> groups[4];
+  size_t pos = 1;
+  for (int i = 0; i < 4; i++) {
+    if (pos >= ints.size() || ints[pos] < 0 || pos + 1 + ints[pos] > ints.size()) {
+      return xla::InvalidArgument("Invalid dot instruction in tape.");
+    }
+    groups[i].assign(ints.begin() + pos + 1, ints.begin() + pos + 1 + ints[pos]);
+    pos += ints[pos] + 1;
+  }
+
+  xla::DotDimensionNumbers dnums;
+  for (int64 dim : groups[0]) dnums.add_lhs_contracting_dimensions(dim);
+  for (int64 dim : groups[1]) dnums.add_lhs_batch_dimensions(dim);
+  for (int64 dim : groups[2]) dnums.add_rhs_contracting_dimensions(dim);
+  for (int64 dim : groups[3]) dnums.add_rhs_batch_dimensions(dim);
+
+  xla::PrecisionConfig config;
+  xla::PrecisionConfig::Precision precision;
+  switch (ints[0]) {
+    case 0: precision = xla::PrecisionConfig::DEFAULT; break;
+    case 1: precision = xla::PrecisionConfig::HIGH; break;
+    default: precision = xla::PrecisionConfig::HIGHEST; break;
+  }
+  config.add_operand_precision(precision);
+  config.add_operand_precision(precision);
+
+  EXLA_ASSIGN_OR_RETURN(xla::XlaOp left, ToType(builder, instruction.operands[0], instruction.type));
+  EXLA_ASSIGN_OR_RETURN(xla::XlaOp right, ToType(builder, instruction.operands[1], instruction.type));
+  return xla::DotGeneral(left, right, dnums, &config);
+}
+
+xla::StatusOr<xla::XlaOp> BuildInstruction(xla::XlaBuilder* builder,
+                                           const std::vector<xla::XlaOp>& parameters,
+                                           const Instruction& instruction,
+                                           std::map<std::pair<int64, xla::PrimitiveType>, xla::XlaComputation>& reducers) {
+  const std::vector<xla::XlaOp>& operands = instruction.operands;
+  const std::vector<int64>& ints = instruction.ints;
+
+  switch (instruction.opcode) {
+    case kParameter:
+      if (ints.size() != 1 || ints[0] < 0 || ints[0] >= parameters.size()) {
+        return xla::InvalidArgument("Invalid parameter in tape.");
+      }
+      return parameters[ints[0]];
+
+    case kConstant: {
+      EXLA_ASSIGN_OR_RETURN(xla::XlaOp op, Literal(builder, instruction, {}));
+      if (instruction.dims.empty()) return op;
+      return xla::BroadcastInDim(op, instruction.dims, {});
+    }
+
+    case kTensor:
+      return Literal(builder, instruction, instruction.dims);
+
+    case kTuple:
+      return xla::Tuple(builder, operands);
+
+    default:
+      break;
+  }
+
+  // All other instructions have at least one operand
+  if (operands.empty()) {
+    return xla::InvalidArgument("Missing operand in tape.");
+  }
+
+  switch (instruction.opcode) {
+    case kReshape:
+      return xla::Reshape(operands[0], instruction.dims);
+
+    case kBroadcast:
+      return xla::BroadcastInDim(operands[0], instruction.dims, ints);
+
+    case kTranspose:
+      return xla::Transpose(operands[0], ints);
+
+    case kConvert:
+      return ToType(builder, operands[0], instruction.type);
+
+    case kSelect: {
+      if (operands.size() != 3) break;
+      EXLA_ASSIGN_OR_RETURN(xla::XlaOp pred, ToType(builder, operands[0], xla::PRED));
+      EXLA_ASSIGN_OR_RETURN(xla::XlaOp on_true, ToType(builder, operands[1], instruction.type));
+      EXLA_ASSIGN_OR_RETURN(xla::XlaOp on_false, ToType(builder, operands[2], instruction.type));
+      EXLA_ASSIGN_OR_RETURN(on_true, BroadcastTo(builder, on_true, instruction.dims));
+      EXLA_ASSIGN_OR_RETURN(on_false, BroadcastTo(builder, on_false, instruction.dims));
+      return xla::Select(pred, on_true, on_false);
+    }
+
+    case kDot:
+      if (operands.size() != 2) break;
+      return Dot(builder, instruction);
+
+    case kReduce:
+      return Reduce(builder, instruction, reducers);
+
+    case kUnary: {
+      if (ints.size() != 1 || ints[0] < 0 || ints[0] >= sizeof(kUnaryOps) / sizeof(kUnaryOps[0])) break;
+      EXLA_ASSIGN_OR_RETURN(xla::XlaOp operand, ToType(builder, operands[0], instruction.type));
+      return kUnaryOps[ints[0]](operand);
+    }
+
+    // Binary instructions convert both operands to the instruction
+    // type, which for comparisons is the type they are compared as.
+    case kBinary: {
+      if (operands.size() != 2 || ints.size() != 1 || ints[0] < 0 ||
+          ints[0] >= sizeof(kBinaryOps) / sizeof(kBinaryOps[0])) break;
+      EXLA_ASSIGN_OR_RETURN(xla::XlaOp left, ToType(builder, operands[0], instruction.type));
+      EXLA_ASSIGN_OR_RETURN(xla::XlaOp right, ToType(builder, operands[1], instruction.type));
+      EXLA_ASSIGN_OR_RETURN(std::vector<int64> dims, BroadcastDimensions(builder, left, right));
+      return kBinaryOps[ints[0]](left, right, dims);
+    }
+
+    default:
+      return xla::InvalidArgument("Unknown opcode %d in tape.", instruction.opcode);
+  }
+
+  return xla::InvalidArgument("Invalid instruction with opcode %d in tape.", instruction.opcode);
+}
+
+}  // namespace
+
+xla::StatusOr<xla::XlaOp> BuildTape(xla::XlaBuilder* builder,
+                                    const std::vector<xla::XlaOp>& parameters,
+                                    const unsigned char* data,
+                                    size_t size) {
+  TapeReader reader(data, size);
+  std::vector<xla::XlaOp> ops;
+  std::map<std::pair<int64, xla::PrimitiveType>, xla::XlaComputation> reducers;
+
+  while (!reader.done()) {
+    EXLA_ASSIGN_OR_RETURN(Instruction instruction, ReadInstruction(reader, ops));
+    EXLA_ASSIGN_OR_RETURN(xla::XlaOp op, BuildInstruction(builder, parameters, instruction, reducers));
+    ops.push_back(op);
+  }
+
+  if (ops.empty()) {
+    return xla::InvalidArgument("Empty tape.");
+  }
+
+  // Errors in the builder are sticky, so we surface them here
+  // instead of checking the shape of every instruction
+  EXLA_EFFECT_OR_RETURN(builder->first_error());
+  return ops.back();
+}
+
+}  // namespace exla
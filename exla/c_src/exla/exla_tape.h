@@ -0,0 +1,26 @@
+#ifndef EXLA_TAPE_H_
+#define EXLA_TAPE_H_
+
+#include <vector>
+
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/statusor.h"
+
+// A tape is a binary encoding of a whole Nx.Defn expression, written
+// by EXLA.Defn.Tape. Building the tape in a single NIF call avoids
+// allocating a resource and going through the VM for every operation,
+// which dominates the build time of large graphs.
+
+namespace exla {
+
+// Builds the instructions in `tape` on `builder` and returns the op
+// of the last instruction, which is the tuple of outputs. `parameters`
+// are the ops referenced by parameter instructions, by position.
+xla::StatusOr<xla::XlaOp> BuildTape(xla::XlaBuilder* builder,
+                                    const std::vector<xla::XlaOp>& parameters,
+                                    const unsigned char* data,
+                                    size_t size);
+
+}  // namespace exla
+
+#endif
@@ -32,6 +32,38 @@ defmodule EXLA do
     * `:device_id` - the default device id to run the computation
         on. Defaults to the `:default_device_id` on the client
 
+    * `:donate` - a list of argument positions (counting each tensor
+      in the flattened arguments) whose memory may be reused for an
+      output of the same type and shape. This avoids doubling memory
+      when a training step returns updated parameters. Donated tensors
+      kept on the device are invalidated after the computation
+
+    * `:num_partitions` - the number of partitions to split the
+      computation across, each running on its own device, using XLA's
+      SPMD partitioner. Only arguments given in `:shard` are split,
+      all others are given whole to every partition. Outputs are
+      gathered and replicated on every partition, and then returned
+      once as whole tensors. Defaults to 1
+
+    * `:shard` - a list of `{position, axis}` tuples, where `position`
+      is an argument position (counting each tensor in the flattened
+      arguments) and `axis` the axis that argument is split on across
+      `:num_partitions` equal parts. For example, to split the batch
+      of the first argument across two host devices:
+
+          EXLA.jit(&predict/2, [batch, params], num_partitions: 2, shard: [{0, 0}])
+
+      Negative axes count from the last axis. Arguments are split on
+      the host and each part is then transferred to its device.
+      Arguments kept on a device are first copied back to the host,
+      so they cross the host on every call
+
+    * `:infeed_depth` - only for streams, the number of chunks sent
+      with `Nx.Stream.send/2` that may be queued for the device. Once
+      the queue is full, `Nx.Stream.send/2` blocks. Defaults to 2,
+      so the next chunk is staged while the device computes on the
+      current one
+
     * `:run_options` - options given when running the computation:
 
       * `:keep_on_device` - if the data should be kept on the device,
@@ -85,9 +117,27 @@ defmodule EXLA do
     * `:memory_fraction` - how much memory of a GPU device to
       allocate. Defaults to `0.9`.
 
+    * `:memory_budget` - how many bytes buffers kept on each device
+      may use. Once exceeded, the least recently used buffers are
+      spilled to host memory and moved back when used again. This
+      allows working with more data than fits on the device, at the
+      cost of transfers. See `EXLA.Client.set_memory_budget/2`.
+      Disabled by default.
+
+    * `:concurrency` - how many computations may run at once on
+      each device. Computations with hooks and streams always hold
+      the device on their own, as they use its infeed and outfeed.
+      Defaults to 1.
+
+    * `:device_count` - the number of devices of a `:host` client.
+      Each device runs one replica of data-parallel computations, so
+      this can be set up to the number of cores. Defaults to 1. It
+      must be configured before XLA is first used, which means the
+      `:host` client must be the first client started
+
   ### GPU Runtime Issues
 
-  GPU Executions run in dirty IO threads, which have a considerable smaller
+  GPU transfers run in dirty IO threads, which have a considerable smaller
   stack size than regular scheduler threads. This may lead to problems with
   certain CUDA or cuDNN versions, leading to segmentation fails. In a development
   environment, it is suggested to set:
@@ -97,6 +147,30 @@ defmodule EXLA do
   To increase the stack size of dirty IO threads from 40 kilowords to
   128 kilowords. In a release, you can set this flag in your `vm.args`.
 
+  ## Compilation cache
+
+  Compiled executables are cached in memory. By default, they are kept
+  for the lifetime of the VM, which can grow without bounds when many
+  different shapes are compiled. The in-memory cache can be bounded:
+
+      config :exla, :defn_cache, max_entries: 1000, max_bytes: 500_000_000
+
+  `:max_entries` limits the number of cached traced expressions and
+  executables and `:max_bytes` limits the estimated size of the
+  compiled code. Once a limit is exceeded, the least recently used
+  entries are evicted and evicted executables are freed once they are
+  no longer in use. Both are disabled by default.
+
+  EXLA can also persist them to disk, so warm starts skip compilation:
+
+      config :exla, :disk_cache, path: "/var/cache/exla", max_size: 1_000_000_000
+
+  The cache key includes the computation, the argument shapes, the
+  client platform and the EXLA version. Once the directory grows over
+  `:max_size` bytes (defaults to 1GB), least recently used entries are
+  removed. Note XLA only supports serializing executables on TPU,
+  elsewhere the disk cache has no effect.
+
   ## Device allocation
 
   EXLA also ships with a `EXLA.DeviceBackend` that allows data
@@ -109,7 +183,9 @@ defmodule EXLA do
   Will keep the computation on the device, either the CPU or GPU.
   For CPU, this is actually detrimental, as allocating an Elixir
   binary has the same cost as keeping it on CPU, but this yields
-  important performance benefits on the GPU.
+  important performance benefits on the GPU. Note that on the host
+  platform, binaries given as inputs and returned as outputs are not
+  copied, as the device memory is the process memory.
 
   If data is kept on the device, you can pipe it into other `defn`
   computations running on the same compiler (in this case, the
@@ -13,6 +13,7 @@ defmodule EXLA.Application do
     children = [
       EXLA.Logger,
       EXLA.Client,
+      EXLA.DiskCache,
       EXLA.Defn.Lock,
       EXLA.Defn.LockedCache,
       {Task.Supervisor, name: EXLA.Defn.TaskSupervisor}
@@ -0,0 +1,364 @@
+defmodule EXLA.Batcher do
+  @moduledoc """
+  A server that batches concurrent calls to a function.
+
+  Calling a jitted function from many processes runs one small
+  computation per call, one after the other. The batcher collects
+  concurrent requests within a latency window, concatenates their
+  inputs along the first axis, runs the function once on the whole
+  batch, and splits the results back to each caller.
+
+  It is started with the function and its arguments, where the
+  batched arguments are given as `:batch`:
+
+      children = [
+        {EXLA.Batcher,
+         name: MyModel.Batcher,
+         function: &MyModel.predict/2,
+         args: [params, :batch],
+         max_batch_size: 32,
+         max_wait: 5}
+      ]
+
+  Then each caller gives its batched inputs, in order:
+
+      EXLA.Batcher.run(MyModel.Batcher, [Nx.tensor([[1.0, 2.0]])])
+
+  The first axis of every batched input is the batch axis and each
+  request may have any number of entries on it. Requests whose inputs
+  differ in type or in the shape of the other axes run in separate
+  batches. The function must return a tensor, or a container of
+  tensors, with the batch axis first, which are sliced back into
+  each request.
+
+  ## Options
+
+    * `:function` - the function to batch (required)
+
+    * `:args` - the function arguments, where batched arguments
+      are given as `:batch` (required)
+
+    * `:max_batch_size` - the maximum number of entries in a batch.
+      A batch runs as soon as it is full. Requests larger than the
+      maximum run on their own. Defaults to 32
+
+    * `:max_wait` - how many milliseconds to wait for the batch to
+      fill up after its first request. Defaults to 5
+
+    * `:pad` - if batches are padded with zeros up to `:max_batch_size`,
+      so the function is compiled once instead of once per batch size.
+      Defaults to `true`
+
+    * `:compiler_options` - options given to `EXLA.jit/3`
+
+    * `:name` - the name of the server
+
+  """
+  use GenServer
+
+  @window 1024
+
+  @doc """
+  Starts a batcher server. See the module docs for options.
+  """
+  def start_link(opts) do
+    {gen_opts, opts} = Keyword.split(opts, [:name])
+    GenServer.start_link(__MODULE__, opts, gen_opts)
+  end
+
+  @doc """
+  Runs the batched function with the given `inputs`.
+
+  `inputs` is a list with one tensor per `:batch` argument.
+  Returns the slice of the results for the given inputs.
+  """
+  def run(server, inputs, timeout \\ 5000) when is_list(inputs) do
+    case GenServer.call(server, {:run, inputs}, timeout) do
+      {:ok, result} -> result
+      {:error, kind, reason, stacktrace} -> :erlang.raise(kind, reason, stacktrace)
+    end
+  end
+
+  @doc """
+  Returns the batcher metrics.
+
+    * `:requests` - the number of requests processed
+    * `:batches` - the number of batches run
+    * `:average_batch_size` - the average number of entries per batch
+    * `:p50` and `:p99` - the latency percentiles in microseconds,
+      from the time a request is received until it is replied,
+      over the last #{@window} requests
+
+  """
+  def metrics(server) do
+    GenServer.call(server, :metrics)
+  end
+
+  ## Callbacks
+
+  @impl true
+  def init(opts) do
+    function = Keyword.fetch!(opts, :function)
+    args = Keyword.fetch!(opts, :args)
+    max_batch_size = Keyword.get(opts, :max_batch_size, 32)
+    max_wait = Keyword.get(opts, :max_wait, 5)
+
+    unless is_function(function, length(args)) do
+      raise ArgumentError, ":function must have one argument per entry in :args"
+    end
+
+    unless is_integer(max_batch_size) and max_batch_size > 0 do
+      raise ArgumentError, ":max_batch_size must be a positive integer"
+    end
+
+    state = %{
+      function: function,
+      args: args,
+      max_batch_size: max_batch_size,
+      max_wait: max_wait,
+      pad: Keyword.get(opts, :pad, true),
+      compiler_options: Keyword.get(opts, :compiler_options, []),
+      pending: [],
+      pending_size: 0,
+      timer: nil,
+      latencies: :queue.new(),
+      latency_count: 0,
+      requests: 0,
+      batches: 0,
+      entries: 0
+    }
+
+    {:ok, state}
+  end
+
+  @impl true
+  def handle_call({:run, inputs}, from, state) do
+    case batch_size(inputs, state.args) do
+      {:ok, size} -> {:noreply, enqueue(from, inputs, size, state)}
+      {:error, message} -> {:reply, {:error, :error, ArgumentError.exception(message), []}, state}
+    end
+  end
+
+  def handle_call(:metrics, _from, state) do
+    %{requests: requests, batches: batches, entries: entries} = state
+    latencies = state.latencies |> :queue.to_list() |> Enum.sort()
+
+    metrics = %{
+      requests: requests,
+      batches: batches,
+      average_batch_size: if(batches > 0, do: entries / batches, else: 0.0),
+      p50: percentile(latencies, 0.5),
+      p99: percentile(latencies, 0.99)
+    }
+
+    {:reply, metrics, state}
+  end
+
+  @impl true
+  # Timers are matched against the current one, as a cancelled
+  # timer may have fired before it was cancelled
+  def handle_info({:timeout, timer, :flush}, %{timer: timer} = state) do
+    {:noreply, flush(%{state | timer: nil}, true)}
+  end
+
+  def handle_info({:latencies, latencies}, state) do
+    {:noreply, Enum.reduce(latencies, state, &record_latency/2)}
+  end
+
+  def handle_info(_, state) do
+    {:noreply, state}
+  end
+
+  defp enqueue(from, inputs, size, state) do
+    request = {from, inputs, size, System.monotonic_time(:microsecond)}
+
+    state = %{state | pending: [request | state.pending], pending_size: state.pending_size + size}
+
+    cond do
+      state.pending_size >= state.max_batch_size ->
+        flush(state, false)
+
+      state.timer == nil ->
+        %{state | timer: start_timer(state)}
+
+      true ->
+        state
+    end
+  end
+
+  defp record_latency(latency, %{latencies: queue, latency_count: count} = state) do
+    queue = :queue.in(latency, queue)
+
+    if count == @window do
+      %{state | latencies: :queue.drop(queue)}
+    else
+      %{state | latencies: queue, latency_count: count + 1}
+    end
+  end
+
+  defp percentile([], _), do: nil
+
+  defp percentile(sorted, p) do
+    index = max(ceil(length(sorted) * p) - 1, 0)
+    Enum.at(sorted, index)
+  end
+
+  ## Batching
+
+  # Runs batches of up to max_batch_size entries until the remaining
+  # requests do not fill a batch or, once the wait is over, until no
+  # requests are pending.
+  defp flush(%{pending: []} = state, _all?), do: state
+
+  defp flush(state, all?) do
+    if state.timer, do: :erlang.cancel_timer(state.timer)
+    {batch, rest, size} = take_batch(Enum.reverse(state.pending), state.max_batch_size)
+
+    state = %{
+      state
+      | pending: Enum.reverse(rest),
+        pending_size: state.pending_size - size,
+        timer: nil,
+        requests: state.requests + length(batch),
+        batches: state.batches + 1,
+        entries: state.entries + size
+    }
+
+    start_batch(batch, size, state)
+
+    cond do
+      state.pending_size >= state.max_batch_size or (all? and state.pending != []) ->
+        flush(state, all?)
+
+      state.pending != [] ->
+        %{state | timer: start_timer(state)}
+
+      true ->
+        state
+    end
+  end
+
+  defp start_timer(state), do: :erlang.start_timer(state.max_wait, self(), :flush)
+
+  # The first request is always taken, even if it is larger than the batch.
+  # Only requests with the same signature as the first one can be concatenated,
+  # the others are skipped and stay pending in order.
+  defp take_batch([{_, inputs, size, _} = request | rest], max) do
+    take_batch(rest, max, signature(inputs), size, [request], [])
+  end
+
+  defp take_batch(
+         [{_, inputs, size, _} = request | rest],
+         max,
+         signature,
+         acc_size,
+         acc,
+         skipped
+       ) do
+    cond do
+      signature(inputs) != signature ->
+        take_batch(rest, max, signature, acc_size, acc, [request | skipped])
+
+      acc_size + size <= max ->
+        take_batch(rest, max, signature, acc_size + size, [request | acc], skipped)
+
+      true ->
+        {Enum.reverse(acc), Enum.reverse(skipped, [request | rest]), acc_size}
+    end
+  end
+
+  defp take_batch([], _max, _signature, acc_size, acc, skipped) do
+    {Enum.reverse(acc), Enum.reverse(skipped), acc_size}
+  end
+
+  defp signature(inputs) do
+    Enum.map(inputs, &{Nx.type(&1), &1 |> Nx.shape() |> Tuple.delete_at(0)})
+  end
+
+  # Batches run in a separate process, so requests keep being
+  # collected while the device computes the current batch.
+  defp start_batch(batch, size, state) do
+    %{function: function, args: args, compiler_options: compiler_options} = state
+    padded_size = if state.pad, do: max(size, state.max_batch_size), else: size
+    server = self()
+
+    Task.Supervisor.start_child(EXLA.Defn.TaskSupervisor, fn ->
+      replies =
+        try do
+          inputs = batch_inputs(batch, size, padded_size)
+          result = EXLA.jit(function, fill_args(args, inputs), compiler_options)
+          split_result(batch, result)
+        catch
+          kind, reason ->
+            error = {:error, kind, reason, __STACKTRACE__}
+            Enum.map(batch, fn {from, _, _, _} -> {from, error} end)
+        end
+
+      # Latencies are recorded before replying, so they are
+      # visible in the metrics once callers get their results
+      now = System.monotonic_time(:microsecond)
+      latencies = Enum.map(batch, fn {_, _, _, received_at} -> now - received_at end)
+      send(server, {:latencies, latencies})
+
+      for {from, reply} <- replies do
+        GenServer.reply(from, reply)
+      end
+    end)
+  end
+
+  defp batch_inputs(batch, size, padded_size) do
+    batch
+    |> Enum.map(fn {_, inputs, _, _} -> inputs end)
+    |> Enum.zip_with(fn tensors ->
+      tensor = Nx.concatenate(tensors, axis: 0)
+
+      if padded_size > size do
+        padding = [{0, padded_size - size, 0} | List.duplicate({0, 0, 0}, Nx.rank(tensor) - 1)]
+        Nx.pad(tensor, 0, padding)
+      else
+        tensor
+      end
+    end)
+  end
+
+  defp fill_args([:batch | args], [input | inputs]), do: [input | fill_args(args, inputs)]
+  defp fill_args([arg | args], inputs), do: [arg | fill_args(args, inputs)]
+  defp fill_args([], []), do: []
+
+  defp split_result(batch, result) do
+    {replies, _offset} =
+      Enum.map_reduce(batch, 0, fn {from, _, size, _}, offset ->
+        slice =
+          Nx.Defn.Composite.traverse(result, fn tensor ->
+            Nx.slice_axis(tensor, offset, size, 0)
+          end)
+
+        {{from, {:ok, slice}}, offset + size}
+      end)
+
+    replies
+  end
+
+  defp batch_size(inputs, args) do
+    expected = Enum.count(args, &(&1 == :batch))
+    shapes = Enum.map(inputs, &Nx.shape/1)
+    sizes = Enum.map(shapes, &(tuple_size(&1) > 0 and elem(&1, 0)))
+
+    cond do
+      length(inputs) != expected ->
+        {:error, "expected #{expected} batched inputs, got: #{length(inputs)}"}
+
+      false in sizes ->
+        {:error,
+         "expected all batched inputs to have a batch axis, got shapes: #{inspect(shapes)}"}
+
+      match?([_], Enum.uniq(sizes)) ->
+        {:ok, hd(sizes)}
+
+      true ->
+        {:error,
+         "expected all batched inputs to have the same size on the first axis, " <>
+           "got: #{inspect(sizes)}"}
+    end
+  end
+end
@@ -19,12 +19,29 @@ defmodule EXLA.Buffer do
   """
   def place_on_device(data, %Shape{} = shape, client = %Client{}, device_id)
       when is_integer(device_id) and is_binary(data) do
-    ref =
-      client.ref
-      |> EXLA.NIF.binary_to_device_mem(data, shape.ref, device_id)
-      |> unwrap!()
+    [buffer] = place_on_device([{data, shape}], client, device_id)
+    buffer
+  end
+
+  @doc """
+  Places all `{binary, shape}` pairs in `data_and_shapes` on the given
+  `device` using `client`.
+
+  All transfers happen concurrently and this function returns once all
+  of them are done, so it is preferred over multiple calls to
+  `place_on_device/4`, for example, when loading model parameters.
+  """
+  def place_on_device(data_and_shapes, client = %Client{}, device_id)
+      when is_list(data_and_shapes) and is_integer(device_id) do
+    refs =
+      Enum.map(data_and_shapes, fn {data, %Shape{ref: ref}} when is_binary(data) -> {data, ref} end)
 
-    %Buffer{ref: ref, client_name: client.name, device_id: device_id, shape: shape}
+    client.ref
+    |> EXLA.NIF.binaries_to_device_mem(refs, device_id)
+    |> unwrap!()
+    |> Enum.zip_with(data_and_shapes, fn ref, {_data, shape} ->
+      %Buffer{ref: ref, client_name: client.name, device_id: device_id, shape: shape}
+    end)
   end
 
   @doc """
@@ -34,9 +51,22 @@ defmodule EXLA.Buffer do
   without destroying it. If `size` is negative, then it
   reads the whole buffer.
   """
-  def read(%Buffer{ref: ref, client_name: client_name}, size \\ -1) do
+  def read(%Buffer{} = buffer, size \\ -1) do
+    read(buffer, 0, size)
+  end
+
+  @doc """
+  Reads `size` bytes starting at byte `offset` from the
+  underlying buffer ref.
+
+  Only the requested bytes are transferred from the device,
+  whenever the platform supports it. If `size` is negative,
+  then it reads until the end of the buffer.
+  """
+  def read(%Buffer{ref: ref, client_name: client_name}, offset, size)
+      when is_integer(offset) and offset >= 0 and is_integer(size) do
     client = EXLA.Client.fetch!(client_name)
-    binary = EXLA.NIF.read_device_mem(client.ref, ref, size) |> unwrap!()
+    binary = EXLA.NIF.read_device_mem(client.ref, ref, offset, size) |> unwrap!()
     binary
   end
 
@@ -19,9 +19,23 @@ defmodule EXLA.Builder do
     %Builder{ref: ref, parent: builder, name: name}
   end
 
-  def build(root = %Op{}) do
+  @doc """
+  Builds the computation with `root` as output.
+
+  ## Options
+
+    * `:aliases` - a list of `{output_index, parameter_number}` pairs.
+      Each pair allows XLA to write the output element at `output_index`
+      of the root tuple into the memory of the given parameter, which
+      must have the same shape. Aliased parameters are donated when the
+      executable runs: buffers given as such arguments are invalidated
+      and can no longer be used.
+
+  """
+  def build(root = %Op{}, options \\ []) do
     shape = EXLA.Op.get_shape(root)
-    {:ok, ref} = EXLA.NIF.build(root.builder, root.ref)
+    aliases = Keyword.get(options, :aliases, [])
+    {:ok, ref} = EXLA.NIF.build(root.builder, root.ref, aliases)
     %Computation{ref: ref, output_shape: shape}
   end
 end
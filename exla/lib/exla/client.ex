@@ -9,7 +9,7 @@ defmodule EXLA.Client do
   @name __MODULE__
 
   @enforce_keys [:ref, :platform, :name, :device_count, :default_device_id]
-  defstruct [:ref, :platform, :name, :device_count, :default_device_id]
+  defstruct [:ref, :platform, :name, :device_count, :default_device_id, concurrency: 1]
 
   @doc """
   Fetches a client with the given `name` from configuration.
@@ -43,6 +43,50 @@ defmodule EXLA.Client do
     end)
   end
 
+  @doc """
+  Returns the memory stats of the device with `device_id`.
+
+  The stats count the device memory held by EXLA buffers, from
+  the moment they are created until they are deallocated or
+  garbage collected:
+
+    * `:allocated_bytes` - the bytes held by live buffers
+    * `:peak_allocated_bytes` - the high-water mark of `:allocated_bytes`
+    * `:live_buffers` - the number of live buffers
+    * `:total_allocations` - the number of buffers ever created
+    * `:total_allocated_bytes` - the bytes of all buffers ever created
+
+    * `:spilled_bytes` - the bytes of buffers spilled to host
+    * `:spilled_buffers` - the number of buffers spilled to host
+    * `:total_spills` - the number of times buffers were spilled
+    * `:memory_budget` - the memory budget of the device, or 0
+
+  The totals are cumulative, so allocation rates can be computed
+  by sampling them periodically. On platforms which report device
+  usage, such as CUDA, `:device_free_bytes` and `:device_total_bytes`
+  are also returned, which include memory held by the allocator
+  itself.
+  """
+  def memory_stats(%EXLA.Client{ref: client}, device_id) when is_integer(device_id) do
+    EXLA.NIF.get_memory_stats(client, device_id) |> unwrap!()
+  end
+
+  @doc """
+  Sets the memory budget, in bytes, of each device of the client.
+
+  Once the buffers on a device exceed the budget, the least recently
+  used ones are spilled to host memory and transparently moved back
+  to the device the next time they are given to a computation.
+  Buffers in use by a running computation are never spilled. Setting
+  it to 0 disables the budget, which is the default.
+
+  It can also be given as the `:memory_budget` client option.
+  """
+  def set_memory_budget(%EXLA.Client{ref: client}, bytes)
+      when is_integer(bytes) and bytes >= 0 do
+    EXLA.NIF.set_memory_budget(client, bytes) |> unwrap!()
+  end
+
   @doc """
   Sends `data_and_shapes` to device infeed.
 
@@ -56,13 +100,39 @@ defmodule EXLA.Client do
   """
   def to_infeed(%EXLA.Client{ref: client}, device_id, data_and_shapes)
       when is_list(data_and_shapes) do
-    data_and_shapes =
-      Enum.map(data_and_shapes, fn
-        {binary, %EXLA.Shape{ref: shape}} when is_binary(binary) -> {[binary], shape}
-        {[binary | _] = data, %EXLA.Shape{ref: shape}} when is_binary(binary) -> {data, shape}
-      end)
+    EXLA.NIF.transfer_to_infeed(client, device_id, infeed_refs(data_and_shapes)) |> unwrap!()
+  end
+
+  @doc """
+  Starts a queue that feeds the device infeed from a native thread.
+
+  `depth` is the number of entries that may be pending, including
+  the one being transferred. A depth of 2 stages the next entry
+  while the device consumes the current one. Entries already queued
+  are transferred even if the queue is garbage collected.
+  """
+  def start_infeed_queue(%EXLA.Client{ref: client}, device_id, depth)
+      when is_integer(depth) and depth > 0 do
+    EXLA.NIF.start_infeed_queue(client, device_id, depth) |> unwrap!()
+  end
+
+  @doc """
+  Queues `data_and_shapes` to be sent to the device infeed by `queue`.
 
-    EXLA.NIF.transfer_to_infeed(client, device_id, data_and_shapes) |> unwrap!()
+  `data_and_shapes` is the same as in `to_infeed/3` and it is sent
+  as a whole, before any entry queued afterwards. It returns as soon
+  as the data is queued, blocking only while the queue is full.
+  Raises if a previous entry failed to transfer.
+  """
+  def enqueue_infeed(queue, data_and_shapes) when is_list(data_and_shapes) do
+    EXLA.NIF.infeed_queue_push(queue, infeed_refs(data_and_shapes)) |> unwrap!()
+  end
+
+  defp infeed_refs(data_and_shapes) do
+    Enum.map(data_and_shapes, fn
+      {binary, %EXLA.Shape{ref: shape}} when is_binary(binary) -> {[binary], shape}
+      {[binary | _] = data, %EXLA.Shape{ref: shape}} when is_binary(binary) -> {data, shape}
+    end)
   end
 
   @doc """
@@ -77,6 +147,53 @@ defmodule EXLA.Client do
     EXLA.NIF.transfer_from_outfeed(client, device_id, shape_refs, pid, ref) |> unwrap!()
   end
 
+  @doc """
+  Starts a native reader of the device outfeed.
+
+  The computation must outfeed a u16 flag followed by the tensors
+  of the given flag, and a 0 flag once it is done. `hooks` is a list
+  of `{flag, shapes}` tuples with the shapes outfed for each flag.
+
+  Messages are read on a dedicated thread and delivered to `pid`
+  in batches as `{ref, {:outfeed, [{flag, binaries}]}}`. Only one
+  batch is delivered at a time: the next one is sent after
+  `ack_outfeed/1` is called. While the consumer falls behind, up
+  to `:capacity` messages are buffered and then the computation
+  blocks on outfeed. Once done, `{ref, :done}` or `{ref, {:error, reason}}`
+  is sent.
+
+  Messages read after the returned reader is garbage collected are
+  discarded.
+
+  ## Options
+
+    * `:capacity` - the number of messages to buffer. Defaults to 16
+
+    * `:max_batch` - the maximum number of messages in a batch.
+      Defaults to 8
+
+  """
+  def start_outfeed_reader(%EXLA.Client{ref: client}, device_id, hooks, pid, ref, opts \\ [])
+      when is_list(hooks) do
+    capacity = Keyword.get(opts, :capacity, 16)
+    max_batch = Keyword.get(opts, :max_batch, 8)
+
+    hooks =
+      for {flag, shapes} <- hooks do
+        {flag, Enum.map(shapes, fn %EXLA.Shape{ref: shape_ref} -> shape_ref end)}
+      end
+
+    EXLA.NIF.start_outfeed_reader(client, device_id, hooks, pid, ref, capacity, max_batch)
+    |> unwrap!()
+  end
+
+  @doc """
+  Acknowledges the last batch delivered by an outfeed `reader`.
+  """
+  def ack_outfeed(reader) do
+    EXLA.NIF.outfeed_reader_ack(reader) |> unwrap!()
+  end
+
   ## Callbacks
 
   @doc false
@@ -99,6 +216,7 @@ defmodule EXLA.Client do
   defp build_client(name, options) do
     platform = Keyword.get(options, :platform)
     default_device_id = Keyword.get(options, :default_device_id, 0)
+    concurrency = Keyword.get(options, :concurrency, 1)
     memory_fraction = Keyword.get(options, :memory_fraction, 0.9)
 
     preallocate = Keyword.get(options, :preallocate, true)
@@ -117,6 +235,7 @@ defmodule EXLA.Client do
           EXLA.NIF.get_host_client()
 
         :host ->
+          if count = options[:device_count], do: force_host_device_count(count)
           EXLA.NIF.get_host_client()
 
         :cuda ->
@@ -135,19 +254,52 @@ defmodule EXLA.Client do
 
     device_count = EXLA.NIF.get_device_count(ref) |> unwrap!()
 
+    if options[:device_count] && options[:device_count] != device_count do
+      raise ArgumentError,
+            "could not start #{inspect(name)} client with #{options[:device_count]} devices, " <>
+              "got #{device_count}. The device count must be configured before XLA is " <>
+              "first used, consider setting XLA_FLAGS=--xla_force_host_platform_device_count=" <>
+              "#{options[:device_count]} instead"
+    end
+
     if default_device_id not in 0..(device_count - 1) do
       raise ArgumentError, ":default_device_id must be a number between 0 and #{device_count - 1}"
     end
 
+    unless is_integer(concurrency) and concurrency > 0 do
+      raise ArgumentError, ":concurrency must be a positive integer, got: #{inspect(concurrency)}"
+    end
+
+    if budget = options[:memory_budget] do
+      :ok = EXLA.NIF.set_memory_budget(ref, budget)
+    end
+
     %EXLA.Client{
       ref: ref,
       platform: platform,
       name: name,
       device_count: device_count,
-      default_device_id: default_device_id
+      default_device_id: default_device_id,
+      concurrency: concurrency
     }
   end
 
+  # The CPU client reads its device count from XLA_FLAGS, which
+  # are parsed once, when XLA is first used.
+  defp force_host_device_count(count) when is_integer(count) and count > 0 do
+    flags =
+      (System.get_env("XLA_FLAGS") || "")
+      |> String.split()
+      |> Enum.reject(&String.starts_with?(&1, "--xla_force_host_platform_device_count="))
+
+    flags = ["--xla_force_host_platform_device_count=#{count}" | flags]
+    System.put_env("XLA_FLAGS", Enum.join(flags, " "))
+  end
+
+  defp force_host_device_count(count) do
+    raise ArgumentError, ":device_count must be a positive integer, got: #{inspect(count)}"
+  end
+
   defp unwrap!(:ok), do: :ok
   defp unwrap!({:ok, ref}), do: ref
   defp unwrap!({:error, error}), do: raise(List.to_string(error))
@@ -0,0 +1,175 @@
+defmodule EXLA.Collective do
+  @moduledoc """
+  Cross-replica collectives for `defn` functions.
+
+  Those functions can be invoked inside `defn` and are compiled to
+  XLA collectives when using the `EXLA` compiler with multiple
+  replicas (see the `:num_replicas` option in `EXLA.Computation.compile/4`).
+  For example, to average gradients across 4 replicas:
+
+      defn average_grads(grads) do
+        EXLA.Collective.all_reduce(grads, op: :sum) / 4
+      end
+
+  All functions accept the `:replica_groups` option, a list of lists
+  of replica ids. The collective happens within each group. It defaults
+  to an empty list, which means all replicas form a single group.
+
+  Outside of EXLA, those functions behave as if there was a single
+  replica, or as if all replicas had the same data, and their gradient
+  is computed as such.
+  """
+
+  import Nx.Defn
+
+  @doc """
+  Reduces `tensor` across replicas.
+
+  ## Options
+
+    * `:op` - one of `:sum`, `:product`, `:max` or `:min`.
+      Defaults to `:sum`
+
+    * `:replica_groups` - the replica groups
+
+  """
+  defn all_reduce(tensor, opts \\ []) do
+    opts = keyword!(opts, op: :sum, replica_groups: [])
+    transform({tensor, opts}, &all_reduce_expr/1)
+  end
+
+  @doc """
+  Concatenates `tensor` from `:shard_count` replicas along `:axis`.
+
+  ## Options
+
+    * `:axis` - the axis to concatenate on. Defaults to 0
+
+    * `:shard_count` - the number of replicas in each group (required)
+
+    * `:replica_groups` - the replica groups
+
+  """
+  defn all_gather(tensor, opts \\ []) do
+    opts = keyword!(opts, [:shard_count, axis: 0, replica_groups: []])
+    transform({tensor, opts}, &all_gather_expr/1)
+  end
+
+  @doc """
+  Reduces `tensor` across replicas and scatters the result along
+  `:axis`, so each replica receives the shard at its position in
+  its group.
+
+  ## Options
+
+    * `:op` - one of `:sum`, `:product`, `:max` or `:min`.
+      Defaults to `:sum`
+
+    * `:axis` - the axis to scatter on. Defaults to 0
+
+    * `:shard_count` - the number of replicas in each group (required)
+
+    * `:replica_groups` - the replica groups
+
+  """
+  defn reduce_scatter(tensor, opts \\ []) do
+    opts = keyword!(opts, [:shard_count, op: :sum, axis: 0, replica_groups: []])
+    transform({tensor, opts}, &reduce_scatter_expr/1)
+  end
+
+  @doc """
+  Splits `tensor` into `:split_count` blocks along `:split_axis`,
+  sends each block to a replica in the group and concatenates the
+  received blocks along `:concat_axis`.
+
+  ## Options
+
+    * `:split_axis` - the axis to split on. Defaults to 0
+
+    * `:concat_axis` - the axis to concatenate on. Defaults to 0
+
+    * `:split_count` - the number of replicas in each group (required)
+
+    * `:replica_groups` - the replica groups
+
+  """
+  defn all_to_all(tensor, opts \\ []) do
+    opts = keyword!(opts, [:split_count, split_axis: 0, concat_axis: 0, replica_groups: []])
+    transform({tensor, opts}, &all_to_all_expr/1)
+  end
+
+  @doc """
+  Sends `tensor` from each source replica to its target replica.
+
+  Replicas which are not a target receive zeros.
+
+  ## Options
+
+    * `:pairs` - a list of `{source, target}` replica ids (required)
+
+  """
+  defn collective_permute(tensor, opts \\ []) do
+    opts = keyword!(opts, [:pairs])
+    transform({tensor, opts}, &collective_permute_expr/1)
+  end
+
+  ## Expressions
+
+  # Collectives are stored as metadata, so other compilers, as well
+  # as grad, see the single replica expression given as fallback.
+
+  defp all_reduce_expr({tensor, opts}) do
+    collective(tensor, tensor, {:all_reduce, opts[:op], opts[:replica_groups]})
+  end
+
+  defp all_gather_expr({tensor, opts}) do
+    count = fetch!(opts, :shard_count)
+    axis = opts[:axis]
+    fallback = Nx.concatenate(List.duplicate(tensor, count), axis: axis)
+    collective(fallback, tensor, {:all_gather, axis, count, opts[:replica_groups]})
+  end
+
+  # As in all_gather, the fallback is the result of the first replica
+  # when all of the :shard_count replicas have the same data
+  defp reduce_scatter_expr({tensor, opts}) do
+    count = fetch!(opts, :shard_count)
+    axis = opts[:axis]
+    op = opts[:op]
+    reduced = reduce_copies(tensor, op, count)
+    fallback = Nx.slice_axis(reduced, 0, div(elem(Nx.shape(tensor), axis), count), axis)
+    collective(fallback, tensor, {:reduce_scatter, op, axis, count, opts[:replica_groups]})
+  end
+
+  defp all_to_all_expr({tensor, opts}) do
+    count = fetch!(opts, :split_count)
+    split = opts[:split_axis]
+    concat = opts[:concat_axis]
+    size = div(elem(Nx.shape(tensor), split), count)
+    blocks = for i <- 0..(count - 1), do: Nx.slice_axis(tensor, i * size, size, split)
+    fallback = Nx.concatenate(blocks, axis: concat)
+    collective(fallback, tensor, {:all_to_all, split, concat, count, opts[:replica_groups]})
+  end
+
+  defp collective_permute_expr({tensor, opts}) do
+    collective(tensor, tensor, {:collective_permute, fetch!(opts, :pairs)})
+  end
+
+  defp reduce_copies(tensor, :sum, count), do: Nx.multiply(tensor, count)
+  defp reduce_copies(tensor, :product, count), do: Nx.power(tensor, count)
+  defp reduce_copies(tensor, op, _count) when op in [:max, :min], do: tensor
+
+  defp reduce_copies(_tensor, op, _count) do
+    raise ArgumentError,
+          "expected :op to be one of :sum, :product, :max or :min, got: #{inspect(op)}"
+  end
+
+  defp fetch!(opts, key) do
+    opts[key] || raise ArgumentError, "expected #{inspect(key)} option to be given"
+  end
+
+  defp collective(fallback, tensor, collective) do
+    tensor = Nx.Defn.Expr.tensor(tensor)
+    metadata = %{exla_collective: {collective, tensor}, inspect: elem(collective, 0)}
+    Nx.Defn.Expr.metadata(Nx.Defn.Expr.tensor(fallback), metadata)
+  end
+end
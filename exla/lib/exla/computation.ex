@@ -6,7 +6,68 @@ defmodule EXLA.Computation do
   @enforce_keys [:ref, :output_shape]
   defstruct [:ref, :output_shape]
 
-  alias EXLA.{Client, Computation, Executable}
+  alias EXLA.{Client, Computation, Executable, Shape}
+
+  @doc """
+  Imports a computation from a serialized `HloModuleProto`.
+
+  This allows computations lowered elsewhere, or exported with
+  `to_hlo_proto/1`, to be compiled without tracing them through
+  `EXLA.Builder`.
+  """
+  def from_hlo_proto(binary) when is_binary(binary) do
+    binary |> EXLA.NIF.computation_from_hlo_proto() |> unwrap!() |> from_ref()
+  end
+
+  @doc """
+  Imports a computation from HLO text, as returned by `to_hlo_text/1`.
+  """
+  def from_hlo_text(text) when is_binary(text) do
+    text |> EXLA.NIF.computation_from_hlo_text() |> unwrap!() |> from_ref()
+  end
+
+  @doc """
+  Reads a computation from the HLO module at `path`.
+
+  Files ending in `.pb` are read as a serialized `HloModuleProto`,
+  all others as HLO text.
+  """
+  def read_hlo!(path) do
+    binary = File.read!(path)
+
+    if Path.extname(path) == ".pb",
+      do: from_hlo_proto(binary),
+      else: from_hlo_text(binary)
+  end
+
+  @doc """
+  Serializes the computation as a `HloModuleProto`.
+  """
+  def to_hlo_proto(%Computation{ref: ref}) do
+    EXLA.NIF.serialize_computation(ref) |> unwrap!()
+  end
+
+  @doc """
+  Returns the computation as HLO text.
+  """
+  def to_hlo_text(%Computation{ref: ref}) do
+    EXLA.NIF.computation_to_hlo_text(ref, 0) |> unwrap!()
+  end
+
+  @doc """
+  Returns the shapes of the computation parameters.
+
+  Those are the argument shapes given to `compile/4`.
+  """
+  def parameter_shapes(%Computation{ref: ref}) do
+    {parameters, _result} = EXLA.NIF.get_program_shape(ref) |> unwrap!()
+    Enum.map(parameters, &Shape.get_shape_info/1)
+  end
+
+  defp from_ref(ref) do
+    {_parameters, result} = EXLA.NIF.get_program_shape(ref) |> unwrap!()
+    %Computation{ref: ref, output_shape: Shape.get_shape_info(result)}
+  end
 
   @doc """
   Compiles a computation into an executable.
@@ -14,39 +75,61 @@ defmodule EXLA.Computation do
   ## Options
 
     * `:device_id` - the device id to compile to and run the executable on.
-      Defaults to the `:default_device_id` on the client.
+      Defaults to the `:default_device_id` on the client, unless there are
+      multiple replicas or partitions, in which case it defaults to `-1`.
 
     * `:num_replicas` - the number of replicas this computation will run on.
       It defaults to 1 but you can set it if you want to enable single-program
-      multiple data
+      multiple data. Executables with a `:device_id` of `-1` run each replica
+      on its own device, see `EXLA.Executable.run/3`.
 
-  Currently those options do not have an effect as they related to running the
-  same compiled executable on multiple replicas.
+    * `:num_partitions` - the number of partitions this computation will run on.
+      Partitions are given by the sharding of parameters and operations (see
+      `EXLA.Op.sharding/2`) and, as replicas, each partition runs on its own
+      device, with its own list of arguments
 
-  Some options apply to TPU only:
-
-    * `:num_partitions` - the number of partitions this computation will run on
+    * `:compile_timeout` - how many milliseconds to wait for compilation,
+      which happens in a native thread pool. Defaults to 30 minutes
 
+  If `config :exla, :disk_cache, path: path` is set, executables are
+  persisted to `path` and loaded back on later compilations of the same
+  computation, on platforms which support executable serialization
+  (currently only TPU).
   """
   def compile(computation = %Computation{}, client = %Client{}, argument_shapes, options \\ []) do
     num_replicas = Keyword.get(options, :num_replicas, 1)
     num_partitions = Keyword.get(options, :num_partitions, 1)
-    device_id = Keyword.get(options, :device_id, client.default_device_id)
+    default_device_id =
+      if num_replicas > 1 or num_partitions > 1, do: -1, else: client.default_device_id
+    device_id = Keyword.get(options, :device_id, default_device_id)
 
     use_spmd = if num_replicas >= 1 or num_partitions >= 1, do: 1, else: 0
     output_shape = assert_output_shape!(computation)
 
+    shape_refs = Enum.map(argument_shapes, & &1.ref)
+    timeout = Keyword.get(options, :compile_timeout, :timer.minutes(30))
+    args = {num_replicas, num_partitions, use_spmd, device_id}
+
     ref =
-      EXLA.NIF.compile(
-        client.ref,
-        computation.ref,
-        Enum.map(argument_shapes, & &1.ref),
-        num_replicas,
-        num_partitions,
-        use_spmd,
-        device_id
-      )
-      |> unwrap!()
+      if disk_cache?(client) do
+        key = disk_cache_key(computation, client, argument_shapes, args)
+
+        with {:ok, serialized} <- EXLA.DiskCache.fetch(key),
+             {:ok, ref} <- deserialize(client, serialized, shape_refs, args) do
+          ref
+        else
+          _ ->
+            ref = compile_async(client, computation, shape_refs, args, timeout)
+
+            with {:ok, serialized} <- EXLA.NIF.serialize_executable(client.ref, ref) do
+              EXLA.DiskCache.put(key, serialized)
+            end
+
+            ref
+        end
+      else
+        compile_async(client, computation, shape_refs, args, timeout)
+      end
 
     %Executable{
       client: client,
@@ -58,6 +141,61 @@ defmodule EXLA.Computation do
     }
   end
 
+  # Compilation happens in a native thread pool, so we don't block
+  # schedulers, and the result is sent back to the current process.
+  defp compile_async(client, computation, shape_refs, args, timeout) do
+    {num_replicas, num_partitions, use_spmd, device_id} = args
+
+    compile_ref =
+      EXLA.NIF.compile_async(
+        client.ref,
+        computation.ref,
+        shape_refs,
+        num_replicas,
+        num_partitions,
+        use_spmd,
+        device_id
+      )
+      |> unwrap!()
+
+    receive do
+      {^compile_ref, result} -> unwrap!(result)
+    after
+      timeout ->
+        raise "timed out after #{timeout}ms while waiting for compilation"
+    end
+  end
+
+  defp deserialize(client, serialized, shape_refs, args) do
+    {num_replicas, num_partitions, use_spmd, device_id} = args
+
+    EXLA.NIF.deserialize_executable(
+      client.ref,
+      serialized,
+      shape_refs,
+      num_replicas,
+      num_partitions,
+      use_spmd,
+      device_id
+    )
+  end
+
+  # XLA only serializes executables on these platforms
+  @serializable_platforms [:tpu]
+
+  defp disk_cache?(client) do
+    client.platform in @serializable_platforms and EXLA.DiskCache.path() != nil
+  end
+
+  # The builder gives instructions ids which differ every time a computation
+  # is built, so the key uses the canonical HLO text, which has none of them
+  defp disk_cache_key(computation, client, argument_shapes, args) do
+    text = EXLA.NIF.computation_to_hlo_text(computation.ref, 1) |> unwrap!()
+    shapes = Enum.map(argument_shapes, &{&1.dtype, &1.dims})
+    vsn = Application.spec(:exla, :vsn)
+    EXLA.DiskCache.key({vsn, client.platform, client.device_count, text, shapes, args})
+  end
+
   defp assert_output_shape!(%{output_shape: output_shape}) do
     if root_tuple_only?(output_shape) do
       output_shape
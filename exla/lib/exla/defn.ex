@@ -11,6 +11,7 @@ defmodule EXLA.Defn do
     run_options = Keyword.put(run_options, :keep_on_device, true)
 
     {client_name, compile_options} = Keyword.pop(compile_options, :client, :host)
+    {infeed_depth, compile_options} = Keyword.pop(compile_options, :infeed_depth, 2)
     client = EXLA.Client.fetch!(client_name)
 
     # The input vars should not be converted to buffers as they come from infeed
@@ -64,7 +65,8 @@ defmodule EXLA.Defn do
       output,
       output_shapes,
       acc_output,
-      keep_on_device?
+      keep_on_device?,
+      infeed_depth
     )
   end
 
@@ -221,19 +223,29 @@ defmodule EXLA.Defn do
     client = EXLA.Client.fetch!(client_name)
     callback = &to_root_computation(key, &1, &2, &3, compile_options)
 
-    {executable, inputs, outputs, hooks, :ok} =
+    {executable, inputs, outputs, hooks, axes} =
       compile(client, key, vars, fun, compile_options, fn _, used -> {[], used} end, callback)
 
-    maybe_outfeed(executable, inputs, outputs, hooks, run_options)
+    if executable.device_id < 0 do
+      partitioned_run(executable, inputs, axes, outputs, hooks, run_options)
+    else
+      maybe_outfeed(executable, inputs, outputs, hooks, run_options)
+    end
   end
 
   defp to_root_computation(key, expr, used_shapes, used_hooks, options) do
     builder = EXLA.Builder.new(inspect(key))
-
-    params =
-      Enum.with_index(used_shapes, fn {pos, shape}, i ->
-        {pos, EXLA.Op.parameter(builder, i, shape, "p#{i}")}
+    num_partitions = Keyword.get(options, :num_partitions, 1)
+    shard = Keyword.get(options, :shard, [])
+
+    {params, axes} =
+      used_shapes
+      |> Enum.with_index(fn {pos, shape}, i ->
+        axis = shard_axis(shard, pos, shape, num_partitions)
+        opts = if axis, do: [sharding: tile_sharding(shape, axis, num_partitions)], else: []
+        {{pos, EXLA.Op.parameter(builder, i, shape, "p#{i}", opts)}, axis}
       end)
+      |> Enum.unzip()
 
     state = %{
       precision: Keyword.get(options, :precision, :highest),
@@ -242,14 +254,106 @@ defmodule EXLA.Defn do
     }
 
     token = EXLA.Op.create_token(builder)
-    {res, cache} = recur_flatten(expr, state, new_cache(token, used_hooks))
+    {res, cache} = recur_root(expr, params, state, new_cache(token, used_hooks))
     {token, used_hooks, outfeed_hooks} = get_hooks(cache)
     close_outfeed(builder, used_hooks, token)
-    {EXLA.Builder.build(res), :ok, outfeed_hooks}
+
+    res = if num_partitions > 1, do: replicate_outputs(builder, res), else: res
+    aliases = donated_aliases(Keyword.get(options, :donate, []), used_shapes, res)
+    {EXLA.Builder.build(res, aliases: aliases), axes, outfeed_hooks}
+  end
+
+  # Expressions are encoded as a tape and built with a single NIF call,
+  # unless they have operations the tape does not support, in which
+  # case they are built operation by operation.
+  defp recur_root(expr, params, state, cache) do
+    indexes = params |> Enum.with_index(fn {pos, _}, i -> {pos, i} end) |> Map.new()
+
+    case EXLA.Defn.Tape.encode(expr, indexes, state.precision) do
+      {:ok, tape} ->
+        ops = Enum.map(params, &elem(&1, 1))
+        {EXLA.Op.from_tape(state.builder, ops, tape), cache}
+
+      :error ->
+        recur_flatten(expr, state, cache)
+    end
   end
 
+  # Sharded parameters are split in equal tiles along a single axis,
+  # one tile per partition, in partition order.
+  defp shard_axis(shard, pos, shape, num_partitions) do
+    case List.keyfind(shard, pos, 0) do
+      {^pos, axis} ->
+        names = List.duplicate(nil, tuple_size(shape.dims))
+        axis = Nx.Shape.normalize_axis(shape.dims, axis, names)
+
+        unless rem(elem(shape.dims, axis), num_partitions) == 0 do
+          raise ArgumentError,
+                "cannot shard argument #{pos} with shape #{inspect(shape.dims)} " <>
+                  "on axis #{axis} across #{num_partitions} partitions"
+        end
+
+        axis
+
+      nil ->
+        nil
+    end
+  end
+
+  defp tile_sharding(shape, axis, num_partitions) do
+    tiles =
+      shape.dims
+      |> Tuple.to_list()
+      |> Enum.with_index(fn _, i -> if i == axis, do: num_partitions, else: 1 end)
+      |> List.to_tuple()
+
+    {tiles, Enum.to_list(0..(num_partitions - 1))}
+  end
+
+  # Outputs are gathered on all partitions, so any of them can be
+  # returned as the result of the computation.
+  defp replicate_outputs(builder, res) do
+    %EXLA.Shape{dtype: {:tuple, shapes}} = EXLA.Op.get_shape(res)
+
+    outputs =
+      Enum.with_index(shapes, fn _, i ->
+        res |> EXLA.Op.get_tuple_element(i) |> EXLA.Op.sharding(:replicated)
+      end)
+
+    EXLA.Op.tuple(builder, outputs)
+  end
+
+  # Alias each donated parameter to the first output of the same shape
+  # which has not been aliased yet. Parameters without a matching output
+  # are not donated.
+  defp donated_aliases([], _used_shapes, _res), do: []
+
+  defp donated_aliases(donate, used_shapes, res) do
+    %EXLA.Shape{dtype: {:tuple, output_shapes}} = EXLA.Op.get_shape(res)
+    outputs = output_shapes |> Enum.map(&{&1.dtype, &1.dims}) |> Enum.with_index()
+
+    {aliases, _} =
+      used_shapes
+      |> Enum.with_index()
+      |> Enum.reduce({[], outputs}, fn {{pos, shape}, i}, {aliases, outputs} ->
+        key = {shape.dtype, shape.dims}
+
+        with true <- pos in donate,
+             {_, output_index} = output <- List.keyfind(outputs, key, 0) do
+          {[{output_index, i} | aliases], List.delete(outputs, output)}
+        else
+          _ -> {aliases, outputs}
+        end
+      end)
+
+    Enum.reverse(aliases)
+  end
+
+  # Executables without hooks may share the device with as many others
+  # as the client allows. Hooks, like streams, rely on the outfeed of
+  # the device and therefore lock it exclusively.
   defp maybe_outfeed(executable, inputs, outputs, hooks, run_options) when hooks == %{} do
-    lock = EXLA.Defn.Lock.lock(run_key(executable))
+    lock = EXLA.Defn.Lock.lock(run_key(executable), executable.client.concurrency)
 
     try do
       EXLA.Executable.run(executable, EXLA.Defn.Buffers.from_nx!(inputs), run_options)
@@ -284,6 +388,62 @@ defmodule EXLA.Defn do
     end
   end
 
+  # Executables running across devices receive one list of arguments
+  # per device, ordered by replica and then by partition. Sharded
+  # arguments are sliced per partition on the host and all others
+  # are given whole to every device. Tensors on a device are copied
+  # to the host first, so each run transfers them twice.
+  defp partitioned_run(executable, inputs, axes, outputs, hooks, run_options) do
+    if hooks != %{} do
+      raise ArgumentError, "hooks are not supported when running on multiple devices"
+    end
+
+    %{num_replicas: num_replicas, num_partitions: num_partitions} = executable
+
+    shards =
+      Enum.zip_with(inputs, axes, fn tensor, axis ->
+        tensor = to_binary_backend(tensor)
+
+        if axis do
+          size = div(elem(tensor.shape, axis), num_partitions)
+          for p <- 0..(num_partitions - 1), do: Nx.slice_axis(tensor, p * size, size, axis)
+        else
+          List.duplicate(tensor, num_partitions)
+        end
+      end)
+
+    arguments =
+      for _replica <- 1..num_replicas, p <- 0..(num_partitions - 1) do
+        shards |> Enum.map(&Enum.at(&1, p)) |> EXLA.Defn.Buffers.from_nx!()
+      end
+
+    # The computation runs on the first devices of the client. They are
+    # locked in order, so concurrent partitioned runs do not deadlock.
+    %{client: %{ref: client_ref}} = executable
+
+    locks =
+      for device_id <- 0..(num_replicas * num_partitions - 1) do
+        EXLA.Defn.Lock.lock([client_ref | device_id])
+      end
+
+    # Outputs are replicated on every partition by the computation,
+    # so the result of the first one is the whole result
+    try do
+      EXLA.Executable.run(executable, arguments, run_options)
+    else
+      [result | _] -> EXLA.Defn.Buffers.to_nx!(result, outputs)
+    after
+      Enum.each(locks, &EXLA.Defn.Lock.unlock/1)
+    end
+  end
+
+  # Device buffers live on a single device, so they are brought
+  # back to the host before being given to every partition
+  defp to_binary_backend(%T{data: %EXLA.DeviceBackend{}} = tensor),
+    do: Nx.backend_copy(tensor, Nx.BinaryBackend)
+
+  defp to_binary_backend(tensor), do: tensor
+
   defp run_key(%{client: %{ref: ref}, device_id: device_id}), do: [ref | device_id]
 
   ## Compile
@@ -319,7 +479,7 @@ defmodule EXLA.Defn do
           to_computation.(expr || fun.(vars), inputs_and_shapes, used_hooks)
 
         executable = EXLA.Computation.compile(computation, client, shapes, options)
-        {nil, {executable, extra, hooks}}
+        {nil, {executable, extra, hooks}, EXLA.Executable.size_bytes(executable)}
       end)
 
     # Now finally compute the hooks to give to outfeed
@@ -472,6 +632,16 @@ defmodule EXLA.Defn do
     {EXLA.Op.tuple(state.builder, []), cache}
   end
 
+  defp cached_recur_operator(
+         :metadata,
+         %T{data: %Expr{args: [_, %{exla_collective: {collective, tensor}}]}} = ans,
+         state,
+         cache
+       ) do
+    {op, cache} = recur_operator(tensor, state, cache)
+    {to_collective(collective, op, ans, state), cache}
+  end
+
   defp cached_recur_operator(op, expr, state, cache) do
     {args, cache} = Tree.apply_args(expr, cache, &recur_operator(&1, state, &2))
     {to_operator(op, args, expr, state), cache}
@@ -769,6 +939,41 @@ defmodule EXLA.Defn do
     end
   end
 
+  ## to_collective
+
+  @collective_ops %{sum: :add, product: :multiply, max: :max, min: :min}
+
+  defp to_collective({:all_reduce, op, groups}, arg, %{type: type}, state) do
+    EXLA.Op.all_reduce(to_type(arg, type), collective_computation(op, type, state), groups)
+  end
+
+  defp to_collective({:all_gather, axis, count, groups}, arg, _ans, _state) do
+    EXLA.Op.all_gather(arg, axis, count, groups)
+  end
+
+  defp to_collective({:reduce_scatter, op, axis, count, groups}, arg, %{type: type}, state) do
+    comp = collective_computation(op, type, state)
+    EXLA.Op.reduce_scatter(to_type(arg, type), comp, axis, count, groups)
+  end
+
+  defp to_collective({:all_to_all, split, concat, count, groups}, arg, _ans, _state) do
+    EXLA.Op.all_to_all(arg, split, concat, count, groups)
+  end
+
+  defp to_collective({:collective_permute, pairs}, arg, _ans, _state) do
+    EXLA.Op.collective_permute(arg, pairs)
+  end
+
+  defp collective_computation(op, type, state) do
+    op =
+      Map.get(@collective_ops, op) ||
+        raise ArgumentError,
+              "expected collective op to be one of #{inspect(Map.keys(@collective_ops))}, " <>
+                "got: #{inspect(op)}"
+
+    op_computation(op, [%{type: type, shape: {}}, %{type: type, shape: {}}], state)
+  end
+
   ## to_operator reduction
 
   defp to_operator(:all, [arg, opts], _ans, state) do
@@ -1,8 +1,12 @@
 defmodule EXLA.Defn.Lock do
   @moduledoc false
 
-  use GenServer
-  require Logger
+  # Keys are spread across shards, each a GenServer holding the
+  # locks of its keys, so lock traffic on different devices does
+  # not go through a single process. Each granted ref is recorded
+  # in a public table pointing to its shard, which is how refs are
+  # routed back on unlock.
+  use Supervisor
 
   @name __MODULE__
   @timeout :infinity
@@ -10,10 +14,14 @@ defmodule EXLA.Defn.Lock do
   @doc """
   Locks the given `key`.
 
-  It will wait until the key becomes available.
+  Up to `concurrency` processes may hold the key at once, as long
+  as the current holders allow as many. The default of 1 locks the
+  key exclusively. It will wait until the key becomes available.
+  Waiters are served in order, so a process asking for an exclusive
+  lock is not starved by shared ones.
   """
-  def lock(key) do
-    GenServer.call(@name, {:lock, key}, @timeout)
+  def lock(key, concurrency \\ 1) when is_integer(concurrency) and concurrency > 0 do
+    GenServer.call(shard(key), {:lock, key, concurrency}, @timeout)
   end
 
   @doc """
@@ -21,7 +29,7 @@ defmodule EXLA.Defn.Lock do
   """
   def transfer(ref, prepare, pid)
       when is_reference(ref) and is_function(prepare, 0) and is_pid(pid) do
-    GenServer.call(@name, {:transfer, ref, prepare, pid}, @timeout)
+    GenServer.call(owner!(ref), {:transfer, ref, prepare, pid}, @timeout)
   end
 
   @doc """
@@ -32,7 +40,7 @@ defmodule EXLA.Defn.Lock do
   def on_unlock(ref, prepare, to_unlock)
       when is_reference(ref) and
              is_function(prepare, 0) and is_function(to_unlock, 0) do
-    GenServer.call(@name, {:on_unlock, ref, prepare, to_unlock}, @timeout)
+    GenServer.call(owner!(ref), {:on_unlock, ref, prepare, to_unlock}, @timeout)
   end
 
   @doc """
@@ -41,81 +49,155 @@ defmodule EXLA.Defn.Lock do
   It will execute the registered `to_unlock` callback, if any.
   """
   def unlock(ref) when is_reference(ref) do
-    GenServer.call(@name, {:unlock, ref}, @timeout)
+    case :ets.lookup(@name, ref) do
+      [{^ref, shard}] -> GenServer.call(shard, {:unlock, ref}, @timeout)
+      [] -> :ok
+    end
+  end
+
+  @doc """
+  Returns the name of the shard process which holds `key`.
+  """
+  def shard(key) do
+    shards = :persistent_term.get({__MODULE__, :shards})
+    :"#{@name}.Shard#{:erlang.phash2(key, shards)}"
+  end
+
+  defp owner!(ref) do
+    case :ets.lookup(@name, ref) do
+      [{^ref, shard}] -> shard
+      [] -> raise ArgumentError, "unknown lock #{inspect(ref)}"
+    end
   end
 
   ## Callbacks
 
   @doc false
-  def start_link(_opts) do
-    GenServer.start_link(__MODULE__, :ok, name: @name)
+  def start_link(opts) do
+    Supervisor.start_link(__MODULE__, opts, name: @name)
   end
 
   @impl true
-  def init(:ok) do
-    Process.flag(:trap_exit, true)
-    {:ok, {%{}, %{}}}
+  def init(opts) do
+    shards = Keyword.get(opts, :shards, System.schedulers_online())
+    :persistent_term.put({__MODULE__, :shards}, shards)
+
+    # The table belongs to the supervisor, so it outlives shard crashes
+    :ets.new(@name, [:named_table, :public, :set, read_concurrency: true])
+
+    children =
+      for i <- 0..(shards - 1) do
+        name = :"#{@name}.Shard#{i}"
+        Supervisor.child_spec({EXLA.Defn.Lock.Shard, name}, id: name)
+      end
+
+    Supervisor.init(children, strategy: :one_for_one)
+  end
+end
+
+defmodule EXLA.Defn.Lock.Shard do
+  @moduledoc false
+
+  use GenServer
+  require Logger
+
+  @table EXLA.Defn.Lock
+
+  def start_link(name) do
+    GenServer.start_link(__MODULE__, name, name: name)
   end
 
   @impl true
-  def handle_call({:lock, key}, from, {refs, devices}) do
-    {refs, devices} =
-      get_and_update_in(devices[key], fn device ->
-        device
-        |> enqueue(from)
-        |> dequeue_if_possible(key, refs)
-      end)
+  def init(name) do
+    Process.flag(:trap_exit, true)
+    # Locks granted by a previous incarnation are gone
+    :ets.match_delete(@table, {:_, name})
+    {:ok, {name, %{}, %{}}}
+  end
+
+  # refs maps each granted ref to {key, to_unlock} and devices maps
+  # each key to {holders, queue}, where holders maps the refs holding
+  # the key to the concurrency they were locked with.
 
-    {:noreply, {refs, devices}}
+  @impl true
+  def handle_call({:lock, key, concurrency}, from, {name, refs, devices}) do
+    {holders, queue} = Map.get(devices, key, {%{}, :queue.new()})
+    queue = :queue.in({from, concurrency}, queue)
+    {refs, device} = dequeue_while_possible(name, key, refs, holders, queue)
+    {:noreply, {name, refs, Map.put(devices, key, device)}}
   end
 
-  def handle_call({:unlock, ref}, _from, {refs, devices}) do
+  def handle_call({:unlock, ref}, _from, {name, refs, devices}) do
     _ = Process.demonitor(ref, [:flush])
-    {:reply, :ok, unlock(ref, refs, devices)}
+    {refs, devices} = unlock(name, ref, refs, devices)
+    {:reply, :ok, {name, refs, devices}}
   end
 
-  def handle_call({:transfer, ref, prepare, pid}, _from, {refs, devices}) do
-    {key, refs} = Map.pop!(refs, ref)
+  def handle_call({:transfer, ref, prepare, pid}, _from, {name, refs, devices}) do
+    {{key, to_unlock}, refs} = Map.pop!(refs, ref)
     _ = Process.demonitor(ref, [:flush])
     _ = prepare.()
-    ref = Process.monitor(pid)
-    {:reply, ref, {Map.put(refs, ref, key), devices}}
+    new_ref = Process.monitor(pid)
+    devices = replace_holder(name, devices, key, ref, new_ref)
+    refs = Map.put(refs, new_ref, {key, to_unlock})
+    {:reply, new_ref, {name, refs, devices}}
   end
 
-  def handle_call({:on_unlock, ref, prepare, to_unlock}, _from, {refs, devices}) do
-    key = Map.fetch!(refs, ref)
+  def handle_call({:on_unlock, ref, prepare, to_unlock}, _from, {name, refs, devices}) do
+    {key, _to_unlock} = Map.fetch!(refs, ref)
     _ = prepare.()
-    devices = update_in(devices[key], fn {_to_unlock, queue} -> {to_unlock, queue} end)
-    {:reply, ref, {refs, devices}}
+    {:reply, ref, {name, Map.put(refs, ref, {key, to_unlock}), devices}}
   end
 
   @impl true
-  def handle_info({:DOWN, ref, _, _, _}, {refs, devices}) do
-    {:noreply, unlock(ref, refs, devices)}
+  def handle_info({:DOWN, ref, _, _, _}, {name, refs, devices}) do
+    {refs, devices} = unlock(name, ref, refs, devices)
+    {:noreply, {name, refs, devices}}
   end
 
-  defp enqueue(nil, entry), do: enqueue({:unlocked, :queue.new()}, entry)
-  defp enqueue({state, queue}, entry), do: {state, :queue.in(entry, queue)}
-
-  defp unlock(ref, refs, devices) do
+  defp unlock(name, ref, refs, devices) do
     case Map.pop(refs, ref, nil) do
       {nil, refs} ->
         {refs, devices}
 
-      {key, refs} ->
-        get_and_update_in(devices[key], fn {to_unlock, queue} ->
-          case run_to_unlock(key, to_unlock) do
-            {:transfer, new} ->
-              ref = Process.monitor(new)
-              {Map.put(refs, ref, key), {fn -> :unlock end, queue}}
-
-            :unlock ->
-              dequeue_if_possible({:unlocked, queue}, key, refs)
-          end
-        end)
+      {{key, to_unlock}, refs} ->
+        case run_to_unlock(key, to_unlock) do
+          {:transfer, new} ->
+            new_ref = Process.monitor(new)
+            devices = replace_holder(name, devices, key, ref, new_ref)
+            {Map.put(refs, new_ref, {key, &default_unlock/0}), devices}
+
+          :unlock ->
+            :ets.delete(@table, ref)
+            {holders, queue} = Map.fetch!(devices, key)
+            holders = Map.delete(holders, ref)
+            {refs, device} = dequeue_while_possible(name, key, refs, holders, queue)
+
+            case device do
+              {holders, queue} when holders == %{} ->
+                if :queue.is_empty(queue),
+                  do: {refs, Map.delete(devices, key)},
+                  else: {refs, Map.put(devices, key, device)}
+
+              _ ->
+                {refs, Map.put(devices, key, device)}
+            end
+        end
     end
   end
 
+  defp replace_holder(name, devices, key, old_ref, new_ref) do
+    :ets.delete(@table, old_ref)
+    :ets.insert(@table, {new_ref, name})
+
+    Map.update!(devices, key, fn {holders, queue} ->
+      {concurrency, holders} = Map.pop!(holders, old_ref)
+      {Map.put(holders, new_ref, concurrency), queue}
+    end)
+  end
+
+  defp default_unlock, do: :unlock
+
   defp run_to_unlock(key, to_unlock) do
     to_unlock.()
   rescue
@@ -128,19 +210,23 @@ defmodule EXLA.Defn.Lock do
       :unlock
   end
 
-  defp dequeue_if_possible({:unlocked, queue}, key, refs) do
-    case :queue.out(queue) do
-      {{:value, {pid, _} = from}, queue} ->
-        ref = Process.monitor(pid)
-        GenServer.reply(from, ref)
-        {Map.put(refs, ref, key), {fn -> :unlock end, queue}}
-
-      {:empty, queue} ->
-        {refs, {:unlocked, queue}}
+  # The next waiter is granted the key while the number of holders is
+  # below both its own concurrency and the concurrency of every current
+  # holder. Waiters are only served in order.
+  defp dequeue_while_possible(name, key, refs, holders, queue) do
+    with {:value, {{pid, _} = from, concurrency}} <- :queue.peek(queue),
+         true <- map_size(holders) < min(concurrency, min_concurrency(holders)) do
+      ref = Process.monitor(pid)
+      :ets.insert(@table, {ref, name})
+      GenServer.reply(from, ref)
+      refs = Map.put(refs, ref, {key, &default_unlock/0})
+      holders = Map.put(holders, ref, concurrency)
+      dequeue_while_possible(name, key, refs, holders, :queue.drop(queue))
+    else
+      _ -> {refs, {holders, queue}}
     end
   end
 
-  defp dequeue_if_possible({to_unlock, queue}, _key, refs) do
-    {refs, {to_unlock, queue}}
-  end
+  defp min_concurrency(holders) when holders == %{}, do: :infinity
+  defp min_concurrency(holders), do: holders |> Map.values() |> Enum.min()
 end
@@ -9,6 +9,16 @@ defmodule EXLA.Defn.LockedCache do
   # Since those resources can be created dynamically,
   # multiple times, they are stored in ETS instead of
   # persistent term.
+  #
+  # The cache may be bounded with:
+  #
+  #     config :exla, :defn_cache, max_entries: 1000, max_bytes: 1_000_000_000
+  #
+  # Every entry records its estimated size and when it was last
+  # used, and the total size is kept in a counter. Once a new entry
+  # goes over any limit, the least recently used entries are evicted
+  # by the server. Evicted executables are freed as soon as no process
+  # references them anymore.
   use GenServer
 
   @name __MODULE__
@@ -28,12 +38,21 @@ defmodule EXLA.Defn.LockedCache do
   @doc """
   Reads cache key or executes the given function if not
   cached yet.
+
+  The function returns `{return, result}`, where only `result`
+  is cached, or `{return, result, bytes}`, where `bytes` is the
+  estimated memory held by `result`.
   """
   def run(key, fun) do
     try do
-      {nil, :ets.lookup_element(@name, key, 2)}
+      result = :ets.lookup_element(@name, key, 2)
+      _ = :ets.update_element(@name, key, {4, stamp()})
+      :counters.add(counters(), 1, 1)
+      {nil, result}
     catch
       :error, :badarg ->
+        :counters.add(counters(), 2, 1)
+
         case GenServer.call(@name, {:lock, key}, @timeout) do
           {:uncached, ref} ->
             try do
@@ -44,17 +63,57 @@ defmodule EXLA.Defn.LockedCache do
                 :erlang.raise(kind, reason, __STACKTRACE__)
             else
               {return, result} ->
-                :ets.insert(@name, {key, result})
-                GenServer.cast(@name, {:cached, ref})
-                {return, result}
+                cache(key, ref, return, result, 0)
+
+              {return, result, bytes} ->
+                cache(key, ref, return, result, bytes)
             end
 
           :cached ->
-            {nil, :ets.lookup_element(@name, key, 2)}
+            # The entry may have been evicted in the meantime
+            case fetch(key) do
+              {:ok, result} -> {nil, result}
+              :error -> run(key, fun)
+            end
         end
     end
   end
 
+  defp cache(key, ref, return, result, bytes) do
+    :ets.insert(@name, {key, result, bytes, stamp()})
+    :counters.add(counters(), 4, bytes)
+    GenServer.cast(@name, {:cached, ref})
+    {return, result}
+  end
+
+  @doc """
+  Returns cache statistics.
+  """
+  def stats do
+    counters = counters()
+
+    %{
+      hits: :counters.get(counters, 1),
+      misses: :counters.get(counters, 2),
+      evictions: :counters.get(counters, 3),
+      entries: :ets.info(@name, :size),
+      bytes: :counters.get(counters, 4)
+    }
+  end
+
+  @doc """
+  Waits until pending evictions are done.
+  """
+  def sync do
+    GenServer.call(@name, :sync, @timeout)
+  end
+
+  defp counters do
+    :persistent_term.get({__MODULE__, :counters})
+  end
+
+  defp stamp, do: :erlang.unique_integer([:monotonic])
+
   ## Callbacks
 
   @doc false
@@ -64,11 +123,16 @@ defmodule EXLA.Defn.LockedCache do
 
   @impl true
   def init(:ok) do
-    :ets.new(@name, [:public, :set, :named_table, read_concurrency: true])
+    :ets.new(@name, [:public, :set, :named_table, read_concurrency: true, write_concurrency: true])
+    :persistent_term.put({__MODULE__, :counters}, :counters.new(4, [:write_concurrency]))
     {:ok, %{keys: %{}, ref_to_key: %{}}}
   end
 
   @impl true
+  def handle_call(:sync, _from, state) do
+    {:reply, :ok, state}
+  end
+
   def handle_call({:lock, key}, from, state) do
     case state.keys do
       %{^key => {ref, waiting}} ->
@@ -85,6 +149,7 @@ defmodule EXLA.Defn.LockedCache do
     {key, state} = pop_in(state.ref_to_key[ref])
     {{^ref, waiting}, state} = pop_in(state.keys[key])
     for from <- waiting, do: GenServer.reply(from, :cached)
+    evict()
     {:noreply, state}
   end
 
@@ -116,4 +181,38 @@ defmodule EXLA.Defn.LockedCache do
       [from | waiting] -> lock(key, from, waiting, state)
     end
   end
+
+  defp evict do
+    config = Application.get_env(:exla, :defn_cache, [])
+    max_entries = config[:max_entries] || :infinity
+    max_bytes = config[:max_bytes] || :infinity
+
+    # Entries are only listed and sorted when there is something to evict
+    over_limit? =
+      :ets.info(@name, :size) > max_entries or :counters.get(counters(), 4) > max_bytes
+
+    if over_limit? do
+      @name
+      |> :ets.select([{{:"$1", :_, :"$2", :"$3"}, [], [{{:"$1", :"$2", :"$3"}}]}])
+      |> Enum.sort_by(&elem(&1, 2), :desc)
+      |> evict(0, 0, max_entries, max_bytes)
+    end
+
+    :ok
+  end
+
+  # Keeps the most recently used entries which fit and evicts the rest.
+  # Numbers compare smaller than atoms, so :infinity is never reached.
+  defp evict([{_key, bytes, _} | entries], count, size, max_entries, max_bytes)
+       when count + 1 <= max_entries and size + bytes <= max_bytes,
+       do: evict(entries, count + 1, size + bytes, max_entries, max_bytes)
+
+  defp evict([{key, bytes, _} | entries], count, size, max_entries, max_bytes) do
+    :ets.delete(@name, key)
+    :counters.add(counters(), 3, 1)
+    :counters.sub(counters(), 4, bytes)
+    evict(entries, count, size, max_entries, max_bytes)
+  end
+
+  defp evict([], _count, _size, _max_entries, _max_bytes), do: :ok
 end
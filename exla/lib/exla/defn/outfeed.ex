@@ -1,6 +1,14 @@
 defmodule EXLA.Defn.Outfeed do
   @moduledoc false
 
+  # Outfeed messages are read by a native thread (see
+  # EXLA.Client.start_outfeed_reader/6), so no dirty scheduler
+  # is blocked while the computation runs. Batches are acked
+  # once all of their messages are delivered, which applies
+  # backpressure on the computation if hooks fall behind.
+  @capacity 16
+  @max_batch 8
+
   @doc """
   Receives a client, device_id, and mappings of u16 to
   `{shapes, {pid, ref} | {fun, template}}` pairs to
@@ -16,47 +24,37 @@ defmodule EXLA.Defn.Outfeed do
   defp init(client, device_id, hooks) do
     Process.flag(:trap_exit, true)
     ref = make_ref()
-    shape = EXLA.Shape.make_shape({:u, 16}, {})
-    loop(client, device_id, ref, shape, hooks)
+    shapes = for {flag, {shapes, _}} <- hooks, do: {flag, shapes}
+    opts = [capacity: @capacity, max_batch: @max_batch]
+    reader = EXLA.Client.start_outfeed_reader(client, device_id, shapes, self(), ref, opts)
+    loop(reader, ref, hooks)
   end
 
-  defp loop(client, device_id, ref, shape, hooks) do
-    :ok = EXLA.Client.from_outfeed(client, device_id, [shape], self(), ref)
-
+  defp loop(reader, ref, hooks) do
     receive do
-      {^ref, <<0::native-unsigned-16>>} ->
-        :ok
-
-      {^ref, <<flag::native-unsigned-16>>} ->
-        case Map.fetch!(hooks, flag) do
-          {shapes, {recv_pid, recv_ref}} when is_pid(recv_pid) ->
-            :ok = EXLA.Client.from_outfeed(client, device_id, shapes, recv_pid, recv_ref)
-            loop(client, device_id, ref, shape, hooks)
-
-          {shapes, {fun, template}} when is_function(fun, 1) ->
-            length = length(shapes)
-            feed_ref = make_ref()
-
-            {hook_pid, hook_ref} =
-              spawn_monitor(fn -> apply_hook(feed_ref, length, fun, template) end)
+      {^ref, {:outfeed, messages}} ->
+        Enum.each(messages, fn {flag, binaries} -> deliver(Map.fetch!(hooks, flag), binaries) end)
+        :ok = EXLA.Client.ack_outfeed(reader)
+        loop(reader, ref, hooks)
 
-            :ok = EXLA.Client.from_outfeed(client, device_id, shapes, hook_pid, feed_ref)
+      {^ref, :done} ->
+        :ok
 
-            receive do
-              {:DOWN, ^hook_ref, _, _, _} -> loop(client, device_id, ref, shape, hooks)
-            end
-        end
+      {^ref, {:error, error}} ->
+        raise List.to_string(error)
     end
   end
 
-  defp apply_hook(ref, length, fun, template) do
-    buffers =
-      for _ <- 1..length//1 do
-        receive do
-          {^ref, binary} -> binary
-        end
-      end
+  defp deliver({_shapes, {recv_pid, recv_ref}}, binaries) when is_pid(recv_pid) do
+    Enum.each(binaries, &send(recv_pid, {recv_ref, &1}))
+  end
+
+  defp deliver({_shapes, {fun, template}}, binaries) when is_function(fun, 1) do
+    {_hook_pid, hook_ref} =
+      spawn_monitor(fn -> fun.(EXLA.Defn.Buffers.to_nx!(binaries, template)) end)
 
-    fun.(EXLA.Defn.Buffers.to_nx!(buffers, template))
+    receive do
+      {:DOWN, ^hook_ref, _, _, _} -> :ok
+    end
   end
 end
@@ -2,7 +2,7 @@ defmodule EXLA.Defn.Stream do
   @moduledoc false
 
   keys =
-    [:lock, :outfeed, :pid, :runner, :send, :recv, :send_shape] ++
+    [:lock, :outfeed, :pid, :runner, :send, :recv, :send_shape, :infeed] ++
       [:recv_length, :done, :client, :device_id, :keep_on_device]
 
   @derive {Inspect, only: [:pid, :client, :device_id, :keep_on_device, :send, :recv]}
@@ -19,10 +19,16 @@ defmodule EXLA.Defn.Stream do
         recv,
         recv_shapes,
         done,
-        keep_on_device?
+        keep_on_device?,
+        infeed_depth
       ) do
     %{client: client, device_id: device_id} = executable
 
+    # Data is sent to the device from a native queue, so send/2
+    # returns once the data is queued and the host can prepare the
+    # next chunk while the device computes on the current one.
+    infeed = EXLA.Client.start_infeed_queue(client, device_id, infeed_depth)
+
     # With the task and outfeed in place, we now register the unlock callback:
     # if the current process shuts down, we send an infeed to stop the loop,
     # and then we block until the outfeed completes.
@@ -30,7 +36,7 @@ defmodule EXLA.Defn.Stream do
       EXLA.Defn.Lock.on_unlock(
         lock,
         fn -> send(runner, lock) end,
-        fn -> halt_stream(client, device_id, outfeed) end
+        fn -> halt_stream(infeed, outfeed) end
       )
 
     %EXLA.Defn.Stream{
@@ -40,6 +46,7 @@ defmodule EXLA.Defn.Stream do
       lock: lock,
       send: send,
       send_shape: send_shape,
+      infeed: infeed,
       recv: recv,
       recv_length: length(recv_shapes),
       client: client,
@@ -49,17 +56,18 @@ defmodule EXLA.Defn.Stream do
     }
   end
 
-  # It is time to halt the stream, we do it by sending 0 for the loop infeed.
-  # Then we wait for the outfeed process to read all.
-  defp halt_stream(client, device_id, outfeed) do
+  # It is time to halt the stream, we do it by sending 0 for the loop infeed,
+  # which is queued after any pending data. Then we wait for the outfeed
+  # process to read all.
+  defp halt_stream(infeed, outfeed) do
     pred = EXLA.Shape.make_shape({:pred, 8}, {})
-    :ok = EXLA.Client.to_infeed(client, device_id, [{<<0::8-native>>, pred}])
+    :ok = EXLA.Client.enqueue_infeed(infeed, [{<<0::8-native>>, pred}])
     {:transfer, outfeed}
   end
 
   defimpl Nx.Stream do
     def send(
-          %{pid: pid, client: client, device_id: device_id, send: send, send_shape: send_shape},
+          %{pid: pid, client: client, infeed: infeed, send: send, send_shape: send_shape},
           data
         ) do
       if pid != self() do
@@ -87,7 +95,7 @@ defmodule EXLA.Defn.Stream do
         end
 
       pred = EXLA.Shape.make_shape({:pred, 8}, {})
-      :ok = EXLA.Client.to_infeed(client, device_id, [{<<1::8-native>>, pred} | data_and_shapes])
+      :ok = EXLA.Client.enqueue_infeed(infeed, [{<<1::8-native>>, pred} | data_and_shapes])
     end
 
     defp nx_to_io(container) do
@@ -0,0 +1,291 @@
+defmodule EXLA.Defn.Tape do
+  @moduledoc false
+
+  # Encodes a defn expression as a binary tape of instructions,
+  # so the whole graph is built by a single NIF call (see
+  # EXLA.Op.from_tape/3) instead of one call per operation.
+  #
+  # Only a subset of operations can be encoded. If the expression
+  # has any other operation, encode/3 returns :error and the caller
+  # must build the expression operation by operation. Support is
+  # checked by walking the graph before anything is encoded, so
+  # unsupported expressions are cheap to reject.
+  #
+  # Each instruction is encoded, in native endianness, as:
+  #
+  #     opcode::8, type::8, rank::8, dims::64*rank,
+  #     operand_count::32, operands::32*operand_count,
+  #     int_count::16, ints::64*int_count,
+  #     byte_size::32, bytes
+  #
+  # where operands are the indexes of previous instructions.
+  # The last instruction is the tuple of outputs. Opcodes, types
+  # and the unary/binary tables must be kept in sync with
+  # c_src/exla/exla_tape.cc.
+
+  alias Nx.Defn.{Composite, Expr}
+  alias Nx.Tensor, as: T
+
+  @opcodes [
+    :parameter,
+    :constant,
+    :tensor,
+    :tuple,
+    :reshape,
+    :broadcast,
+    :transpose,
+    :convert,
+    :select,
+    :dot,
+    :reduce,
+    :unary,
+    :binary
+  ]
+
+  @types [{:pred, 8}, {:s, 8}, {:s, 16}, {:s, 32}, {:s, 64}] ++
+           [{:u, 8}, {:u, 16}, {:u, 32}, {:u, 64}] ++
+           [{:f, 16}, {:bf, 16}, {:f, 32}, {:f, 64}, {:c, 64}, {:c, 128}]
+
+  @unary [:abs, :negate, :exp, :expm1, :log, :log1p, :logistic, :cos, :sin, :tanh] ++
+           [:sqrt, :rsqrt, :cbrt, :floor, :ceil, :round, :bitwise_not, :population_count] ++
+           [:count_leading_zeros, :acos, :asin, :atan, :cosh, :sinh, :acosh, :asinh] ++
+           [:atanh, :erf, :erfc, :erf_inv]
+
+  @binary [:add, :subtract, :multiply, :divide, :remainder, :min, :max, :power, :atan2] ++
+            [:bitwise_and, :bitwise_or, :bitwise_xor, :left_shift, :right_shift_logical] ++
+            [:right_shift_arithmetic, :equal, :not_equal, :greater, :less, :greater_equal] ++
+            [:less_equal]
+
+  @comparison [:equal, :not_equal, :greater, :less, :greater_equal, :less_equal]
+  @logical [logical_and: :bitwise_and, logical_or: :bitwise_or, logical_xor: :bitwise_xor]
+  @reducers [sum: 0, product: 1, reduce_max: 2, reduce_min: 3]
+  @reductions Keyword.keys(@reducers)
+
+  for {name, code} <- Enum.with_index(@opcodes) do
+    defp opcode(unquote(name)), do: unquote(code)
+  end
+
+  for {type, code} <- Enum.with_index(@types) do
+    defp type_code(unquote(type)), do: unquote(code)
+  end
+
+  for {name, code} <- Enum.with_index(@unary) do
+    defp unary_code(unquote(name)), do: unquote(code)
+  end
+
+  for {name, code} <- Enum.with_index(@binary) do
+    defp binary_code(unquote(name)), do: unquote(code)
+  end
+
+  @doc """
+  Encodes the given composite expression.
+
+  `params` maps parameter positions to their index in the list
+  of parameters given when building the tape. Returns `{:ok, tape}`
+  or `:error` if the expression has unsupported operations.
+  """
+  def encode(expr, params, precision) do
+    if supported?(expr) do
+      state = %{params: params, precision: precision(precision)}
+
+      {outputs, tape} =
+        Composite.reduce(expr, {[], {%{}, 0, []}}, fn %T{} = t, {outputs, tape} ->
+          {index, tape} = recur(t, state, tape)
+          {[index | outputs], tape}
+        end)
+
+      tuple = %{type: {:pred, 8}, shape: {}}
+      {_, {_, _, acc}} = emit(tape, :tuple, tuple, Enum.reverse(outputs))
+      {:ok, acc |> Enum.reverse() |> IO.iodata_to_binary()}
+    else
+      :error
+    end
+  end
+
+  defp recur(%T{data: %Expr{id: id, op: op, args: args}} = t, state, {ids, _, _} = tape) do
+    case ids do
+      %{^id => index} ->
+        {index, tape}
+
+      %{} ->
+        {index, {ids, count, acc}} = instruction(op, args, t, state, tape)
+        {index, {Map.put(ids, id, index), count, acc}}
+    end
+  end
+
+  ## Support
+
+  @leaves [:parameter, :constant, :tensor]
+  @shape_ops [:reshape, :squeeze, :broadcast, :transpose, :as_type, :select, :dot]
+  @binary_like @comparison ++ Keyword.keys(@logical) ++ [:quotient, :right_shift] ++ @binary
+
+  defp supported?(expr) do
+    Composite.reduce(expr, %{}, fn %T{} = t, seen -> check(t, seen) end)
+    true
+  catch
+    {__MODULE__, :unsupported} -> false
+  end
+
+  defp check(%T{data: %Expr{id: id, op: op, args: args}}, seen) do
+    cond do
+      Map.has_key?(seen, id) ->
+        seen
+
+      op in @leaves ->
+        Map.put(seen, id, true)
+
+      supported_op?(op, args) ->
+        args |> operands() |> Enum.reduce(Map.put(seen, id, true), &check/2)
+
+      true ->
+        unsupported()
+    end
+  end
+
+  defp supported_op?(:metadata, [_expr, metadata]) do
+    not Map.has_key?(metadata, :exla_collective)
+  end
+
+  defp supported_op?(op, _args) do
+    op in @shape_ops or op in @reductions or op in @unary or op in @binary_like
+  end
+
+  defp operands(args), do: Enum.filter(args, &match?(%T{}, &1))
+
+  ## Instructions
+
+  defp instruction(:parameter, [i], t, state, tape) do
+    emit(tape, :parameter, t, [], [Map.fetch!(state.params, i)])
+  end
+
+  defp instruction(:metadata, [expr, _metadata], _t, state, tape) do
+    recur(expr, state, tape)
+  end
+
+  defp instruction(:constant, [constant], t, _state, tape) do
+    emit(tape, :constant, t, [], [], number_to_binary(constant, t.type))
+  end
+
+  defp instruction(:tensor, [tensor], t, _state, tape) do
+    emit(tape, :tensor, t, [], [], Nx.to_binary(tensor))
+  end
+
+  defp instruction(op, [arg | _], t, state, tape) when op in [:reshape, :squeeze] do
+    {arg, tape} = recur(arg, state, tape)
+    emit(tape, :reshape, t, [arg])
+  end
+
+  defp instruction(:broadcast, [arg, _shape, axes], t, state, tape) do
+    {arg, tape} = recur(arg, state, tape)
+    emit(tape, :broadcast, t, [arg], axes)
+  end
+
+  defp instruction(:transpose, [arg, axes], t, state, tape) do
+    {arg, tape} = recur(arg, state, tape)
+    emit(tape, :transpose, t, [arg], axes)
+  end
+
+  defp instruction(:as_type, [arg], t, state, tape) do
+    {arg, tape} = recur(arg, state, tape)
+    emit(tape, :convert, t, [arg])
+  end
+
+  defp instruction(:select, [pred, on_true, on_false], t, state, tape) do
+    {operands, tape} = recur_all([pred, on_true, on_false], state, tape)
+    emit(tape, :select, t, operands)
+  end
+
+  defp instruction(:dot, [left, c1, b1, right, c2, b2], t, state, tape) do
+    {operands, tape} = recur_all([left, right], state, tape)
+    ints = [state.precision | Enum.flat_map([c1, b1, c2, b2], &[length(&1) | &1])]
+    emit(tape, :dot, t, operands, ints)
+  end
+
+  defp instruction(op, [arg, opts], t, state, tape) when op in @reductions do
+    axes = if axes = opts[:axes], do: Enum.sort(axes), else: Nx.axes(arg)
+    keep_axes = if opts[:keep_axes], do: 1, else: 0
+    {arg, tape} = recur(arg, state, tape)
+    ints = [Keyword.fetch!(@reducers, op), keep_axes | axes]
+    emit(tape, :reduce, t, [arg], ints, initial_value(op, t.type))
+  end
+
+  defp instruction(op, [arg], t, state, tape) when op in @unary do
+    {arg, tape} = recur(arg, state, tape)
+    emit(tape, :unary, t, [arg], [unary_code(op)])
+  end
+
+  # Comparisons are done in the merged type of their operands
+  defp instruction(op, [left, right], t, state, tape) when op in @comparison do
+    binary(op, Nx.Type.merge(left.type, right.type), left, right, t, state, tape)
+  end
+
+  for {logical, bitwise} <- @logical do
+    defp instruction(unquote(logical), [left, right], t, state, tape) do
+      binary(unquote(bitwise), {:pred, 8}, left, right, t, state, tape)
+    end
+  end
+
+  defp instruction(:quotient, [left, right], t, state, tape) do
+    binary(:divide, t.type, left, right, t, state, tape)
+  end
+
+  defp instruction(:right_shift, [left, right], t, state, tape) do
+    op = if match?({:u, _}, t.type), do: :right_shift_logical, else: :right_shift_arithmetic
+    binary(op, t.type, left, right, t, state, tape)
+  end
+
+  defp instruction(op, [left, right], t, state, tape) when op in @binary do
+    binary(op, t.type, left, right, t, state, tape)
+  end
+
+  defp instruction(op, _args, _t, _state, _tape) do
+    raise ArgumentError, "cannot encode #{inspect(op)} in a tape"
+  end
+
+  # Binary instructions convert their operands to the instruction type
+  defp binary(op, type, left, right, t, state, tape) do
+    {operands, tape} = recur_all([left, right], state, tape)
+    emit(tape, :binary, %{t | type: type}, operands, [binary_code(op)])
+  end
+
+  defp recur_all(args, state, tape) do
+    Enum.map_reduce(args, tape, &recur(&1, state, &2))
+  end
+
+  defp initial_value(:sum, type), do: number_to_binary(0, type)
+  defp initial_value(:product, type), do: number_to_binary(1, type)
+  defp initial_value(:reduce_max, type), do: Nx.Type.min_value_binary(type)
+  defp initial_value(:reduce_min, type), do: Nx.Type.max_value_binary(type)
+
+  defp number_to_binary(number, type) do
+    number = Nx.Type.cast_number!(type, number)
+    Nx.tensor(number, type: type, backend: Nx.BinaryBackend) |> Nx.to_binary()
+  end
+
+  defp precision(:default), do: 0
+  defp precision(:high), do: 1
+  defp precision(:highest), do: 2
+
+  defp unsupported, do: throw({__MODULE__, :unsupported})
+
+  ## Encoding
+
+  defp emit(tape, opcode, t, operands, ints \\ [], bytes \\ "")
+
+  defp emit({ids, count, acc}, opcode, %{type: type, shape: shape}, operands, ints, bytes) do
+    dims = Tuple.to_list(shape)
+
+    instruction = [
+      <<opcode(opcode)::8, type_code(type)::8, length(dims)::8>>,
+      Enum.map(dims, &<<&1::64-signed-native>>),
+      <<length(operands)::32-native>>,
+      Enum.map(operands, &<<&1::32-native>>),
+      <<length(ints)::16-native>>,
+      Enum.map(ints, &<<&1::64-signed-native>>),
+      <<byte_size(bytes)::32-native>>,
+      bytes
+    ]
+
+    {count, {ids, count + 1, [instruction | acc]}}
+  end
+end
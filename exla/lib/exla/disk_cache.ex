@@ -0,0 +1,163 @@
+defmodule EXLA.DiskCache do
+  @moduledoc false
+
+  # Persists serialized executables across VM restarts so
+  # warm starts can skip XLA compilation entirely.
+  #
+  # Entries are files named after the cache key. Reads go
+  # directly to disk from the caller, writes are done via a
+  # temporary file followed by a rename, so concurrent readers
+  # never see partial entries. Only eviction goes through the
+  # server, so we have a single process deleting files.
+  #
+  # The cache is configured with:
+  #
+  #     config :exla, :disk_cache, path: "/tmp/exla", max_size: 1_000_000_000
+  #
+  # and it is disabled unless a path is given.
+  use GenServer
+
+  @name __MODULE__
+  @default_max_size 1_000_000_000
+
+  @doc """
+  Returns the cache path if the cache is enabled, nil otherwise.
+  """
+  def path do
+    Application.get_env(:exla, :disk_cache, [])[:path]
+  end
+
+  @doc """
+  Builds a cache key from the given term.
+  """
+  def key(term) do
+    :crypto.hash(:sha256, :erlang.term_to_binary(term)) |> Base.encode16(case: :lower)
+  end
+
+  @doc """
+  Reads the cache key.
+  """
+  def fetch(key) do
+    if path = path() do
+      file = Path.join(path, key)
+
+      case File.read(file) do
+        {:ok, binary} ->
+          # Touch the entry so eviction is least recently used
+          _ = File.touch(file)
+          :counters.add(counters(), 1, 1)
+          {:ok, binary}
+
+        {:error, _} ->
+          :counters.add(counters(), 2, 1)
+          :error
+      end
+    else
+      :error
+    end
+  end
+
+  @doc """
+  Writes the cache key, evicting old entries if over the limit.
+  """
+  def put(key, binary) when is_binary(binary) do
+    if path = path() do
+      file = Path.join(path, key)
+      tmp = file <> ".#{System.unique_integer([:positive])}.tmp"
+
+      with :ok <- File.mkdir_p(path),
+           :ok <- File.write(tmp, binary),
+           :ok <- File.rename(tmp, file) do
+        GenServer.cast(@name, :evict)
+        :ok
+      else
+        _ ->
+          _ = File.rm(tmp)
+          :error
+      end
+    else
+      :error
+    end
+  end
+
+  @doc """
+  Returns cache statistics.
+  """
+  def stats do
+    counters = counters()
+    entries = entries(path())
+
+    %{
+      hits: :counters.get(counters, 1),
+      misses: :counters.get(counters, 2),
+      entries: length(entries),
+      size: entries |> Enum.map(&elem(&1, 1)) |> Enum.sum()
+    }
+  end
+
+  @doc """
+  Waits until pending evictions are done.
+  """
+  def sync do
+    GenServer.call(@name, :sync, :infinity)
+  end
+
+  defp counters do
+    :persistent_term.get({__MODULE__, :counters})
+  end
+
+  defp entries(nil), do: []
+
+  defp entries(path) do
+    case File.ls(path) do
+      {:ok, files} ->
+        for file <- files,
+            Path.extname(file) != ".tmp",
+            full = Path.join(path, file),
+            {:ok, %{type: :regular, size: size, mtime: mtime}} <- [File.stat(full, time: :posix)],
+            do: {full, size, mtime}
+
+      {:error, _} ->
+        []
+    end
+  end
+
+  ## Callbacks
+
+  @doc false
+  def start_link(_opts) do
+    GenServer.start_link(__MODULE__, :ok, name: @name)
+  end
+
+  @impl true
+  def init(:ok) do
+    :persistent_term.put({__MODULE__, :counters}, :counters.new(2, [:write_concurrency]))
+    {:ok, :ok}
+  end
+
+  @impl true
+  def handle_call(:sync, _from, state) do
+    {:reply, :ok, state}
+  end
+
+  @impl true
+  def handle_cast(:evict, state) do
+    if path = path() do
+      max_size = Application.get_env(:exla, :disk_cache, [])[:max_size] || @default_max_size
+      entries = path |> entries() |> Enum.sort_by(&elem(&1, 2), :desc)
+      evict(entries, max_size)
+    end
+
+    {:noreply, state}
+  end
+
+  defp evict([{_file, size, _} | entries], max_size) when size <= max_size,
+    do: evict(entries, max_size - size)
+
+  defp evict([{file, _, _} | entries], max_size) do
+    _ = File.rm(file)
+    evict(entries, max_size)
+  end
+
+  defp evict([], _max_size), do: :ok
+end
@@ -17,35 +17,86 @@ defmodule EXLA.Executable do
     * `:keep_on_device` - if the data should be kept on the device
       after the computation (defaults to `false`).
 
+  If the executable was compiled with a `:device_id` of `-1`, it runs
+  as `:num_replicas` replicas times `:num_partitions` partitions, each
+  on its own device. In this case, `arguments` must be a list with one
+  list of arguments per device and one list of results is returned per
+  device. Arguments to sharded parameters are given as the shard of each
+  partition, and results are the shard computed by each partition. On the host, the
+  number of devices is configured with the `:device_count` client
+  option.
+
+  Arguments for parameters aliased to outputs, via the `:aliases` option
+  in `EXLA.Builder.build/2`, are donated to the computation: XLA reuses
+  their memory for the outputs, so peak memory does not double. Binaries,
+  and `EXLA.Buffer`s placed on the host without copying, which point to
+  the memory of a binary, are copied before being donated. Any other
+  `EXLA.Buffer` is invalidated and raises if used again.
   """
   def run(%Executable{} = executable, arguments, options \\ []) do
-    %{client: client, device_id: device_id, output_shape: output_shape} = executable
-    {data, _} = run(client, executable, arguments, options)
-    decompose_output(data, output_shape, client, device_id)
+    executable
+    |> run_async(arguments, options)
+    |> await(executable)
   end
 
-  defp run(client, executable, arguments, options) do
-    %{ref: exec} = executable
+  @doc """
+  Starts running the given executable with arguments without blocking.
+
+  The execution is enqueued on the device and a reference is returned
+  immediately. The results are sent to the current process once all
+  outputs are ready and they must be retrieved with `await/3`. Many
+  executions may be in flight at the same time.
+
+  It accepts the same options as `run/3`.
+  """
+  def run_async(%Executable{} = executable, arguments, options \\ []) do
+    %{client: client, ref: exec, device_id: device_id} = executable
 
     keep_on_device = Keyword.get(options, :keep_on_device, false)
     keep_on_device_int = if keep_on_device, do: 1, else: 0
 
     inputs =
-      Enum.map(arguments, fn
-        %Buffer{ref: ref} -> ref
-        %BinaryBuffer{data: data, shape: shape} -> {data, shape.ref}
-      end)
+      if device_id < 0,
+        do: Enum.map(arguments, &to_inputs/1),
+        else: to_inputs(arguments)
 
-    data =
-      case client.platform do
-        :host ->
-          EXLA.NIF.run_cpu(client.ref, exec, inputs, keep_on_device_int, executable.device_id)
+    EXLA.NIF.run_async(client.ref, exec, inputs, keep_on_device_int, device_id)
+    |> unwrap!()
+  end
 
-        _ ->
-          EXLA.NIF.run_io(client.ref, exec, inputs, keep_on_device_int, executable.device_id)
-      end
+  @doc """
+  Awaits the results of an execution started with `run_async/3`.
+  """
+  def await(ref, %Executable{} = executable, timeout \\ :infinity) when is_reference(ref) do
+    %{client: client, device_id: device_id, output_shape: output_shape} = executable
 
-    unwrap!(data)
+    receive do
+      {^ref, result} when device_id < 0 ->
+        for {data, device_id} <- unwrap!(result),
+            do: decompose_output(data, output_shape, client, device_id)
+
+      {^ref, result} ->
+        {data, device_id} = unwrap!(result)
+        decompose_output(data, output_shape, client, device_id)
+    after
+      timeout -> exit({:timeout, {__MODULE__, :await, [ref, executable, timeout]}})
+    end
+  end
+
+  @doc """
+  Returns an estimate, in bytes, of the memory held by the compiled code.
+
+  The memory is freed once the executable is garbage collected.
+  """
+  def size_bytes(%Executable{ref: exec}) do
+    EXLA.NIF.get_executable_size(exec) |> unwrap!()
+  end
+
+  defp to_inputs(arguments) do
+    Enum.map(arguments, fn
+      %Buffer{ref: ref} -> ref
+      %BinaryBuffer{data: data, shape: shape} -> {data, shape.ref}
+    end)
   end
 
   defp decompose_output(data, shape, client, device_id) do
@@ -24,7 +24,13 @@ defmodule EXLA.NIF do
   def make_tuple_shape(_shapes),
     do: :erlang.nif_error(:undef)
 
-  def parameter(_builder, _number, _shape, _name),
+  def parameter(_builder, _number, _shape, _name, _sharding),
+    do: :erlang.nif_error(:undef)
+
+  def sharding(_operand, _sharding),
+    do: :erlang.nif_error(:undef)
+
+  def build_tape(_builder, _parameters, _tape),
     do: :erlang.nif_error(:undef)
 
   binary_broadcast_ops =
@@ -198,6 +204,23 @@ defmodule EXLA.NIF do
   def variadic_sort(_operands, _comparator, _dimension),
     do: :erlang.nif_error(:undef)
 
+  def replica_id(_builder), do: :erlang.nif_error(:undef)
+
+  def all_reduce(_operand, _computation, _replica_groups),
+    do: :erlang.nif_error(:undef)
+
+  def all_gather(_operand, _all_gather_dimension, _shard_count, _replica_groups),
+    do: :erlang.nif_error(:undef)
+
+  def reduce_scatter(_operand, _computation, _scatter_dimension, _shard_count, _replica_groups),
+    do: :erlang.nif_error(:undef)
+
+  def all_to_all(_operand, _split_dimension, _concat_dimension, _split_count, _replica_groups),
+    do: :erlang.nif_error(:undef)
+
+  def collective_permute(_operand, _source_target_pairs),
+    do: :erlang.nif_error(:undef)
+
   def tuple(_builder, _elements), do: :erlang.nif_error(:undef)
 
   def get_tuple_element(_operand, _index), do: :erlang.nif_error(:undef)
@@ -237,10 +260,16 @@ defmodule EXLA.NIF do
   def get_device_count(_client),
     do: :erlang.nif_error(:undef)
 
-  def build(_builder, _root),
+  def get_memory_stats(_client, _device_id),
+    do: :erlang.nif_error(:undef)
+
+  def set_memory_budget(_client, _bytes),
+    do: :erlang.nif_error(:undef)
+
+  def build(_builder, _root, _aliases),
     do: :erlang.nif_error(:undef)
 
-  def compile(
+  def compile_async(
         _client,
         _computation,
         _argument_layouts,
@@ -251,16 +280,39 @@ defmodule EXLA.NIF do
       ),
       do: :erlang.nif_error(:undef)
 
-  def run_cpu(
+  def serialize_computation(_computation),
+    do: :erlang.nif_error(:undef)
+
+  def computation_from_hlo_proto(_binary),
+    do: :erlang.nif_error(:undef)
+
+  def computation_from_hlo_text(_text),
+    do: :erlang.nif_error(:undef)
+
+  def computation_to_hlo_text(_computation, _canonical),
+    do: :erlang.nif_error(:undef)
+
+  def get_program_shape(_computation),
+    do: :erlang.nif_error(:undef)
+
+  def get_executable_size(_executable),
+    do: :erlang.nif_error(:undef)
+
+  def serialize_executable(_client, _executable),
+    do: :erlang.nif_error(:undef)
+
+  def deserialize_executable(
         _client,
-        _executable,
-        _arguments,
-        _keep_on_device,
+        _serialized,
+        _argument_layouts,
+        _num_replicas,
+        _num_partitions,
+        _use_spmd,
         _device_id
       ),
       do: :erlang.nif_error(:undef)
 
-  def run_io(
+  def run_async(
         _client,
         _executable,
         _arguments,
@@ -269,10 +321,10 @@ defmodule EXLA.NIF do
       ),
       do: :erlang.nif_error(:undef)
 
-  def binary_to_device_mem(_client, _binary, _shape, _device_ordinal),
+  def binaries_to_device_mem(_client, _data_and_shapes, _device_ordinal),
     do: :erlang.nif_error(:undef)
 
-  def read_device_mem(_client, _buffer, _size),
+  def read_device_mem(_client, _buffer, _offset, _size),
     do: :erlang.nif_error(:undef)
 
   def deallocate_device_mem(_buffer),
@@ -281,9 +333,21 @@ defmodule EXLA.NIF do
   def transfer_to_infeed(_client, _device, _data_shapes),
     do: :erlang.nif_error(:undef)
 
+  def start_infeed_queue(_client, _device, _depth),
+    do: :erlang.nif_error(:undef)
+
+  def infeed_queue_push(_queue, _data_shapes),
+    do: :erlang.nif_error(:undef)
+
   def transfer_from_outfeed(_client, _device, _shapes, _pid, _ref),
     do: :erlang.nif_error(:undef)
 
+  def start_outfeed_reader(_client, _device, _hooks, _pid, _ref, _capacity, _max_batch),
+    do: :erlang.nif_error(:undef)
+
+  def outfeed_reader_ack(_reader),
+    do: :erlang.nif_error(:undef)
+
   def start_log_sink(_sink_pid),
     do: :erlang.nif_error(:undef)
 end
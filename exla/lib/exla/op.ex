@@ -42,10 +42,50 @@ defmodule EXLA.Op do
 
   @doc """
   Specifies a parameter at position `i` with `shape` and `name`.
+
+  ## Options
+
+    * `:sharding` - how the parameter is split across partitions,
+      see `sharding/2`
+
   """
-  def parameter(%Builder{ref: builder}, i, %Shape{ref: shape}, name)
+  def parameter(%Builder{ref: builder}, i, %Shape{ref: shape}, name, opts \\ [])
       when is_integer(i) and i >= 0 and is_binary(name) do
-    ref = EXLA.NIF.parameter(builder, i, shape, name) |> unwrap!()
+    sharding = Keyword.get(opts, :sharding)
+    ref = EXLA.NIF.parameter(builder, i, shape, name, sharding) |> unwrap!()
+    %Op{builder: builder, ref: ref}
+  end
+
+  @doc """
+  Builds all operations in `tape` with a single call.
+
+  The tape is a binary encoding of operations, written by
+  `EXLA.Defn.Tape`, and `parameters` are the operations it
+  refers to as parameters. Returns the last operation in the
+  tape.
+  """
+  def from_tape(%Builder{ref: builder}, parameters, tape) when is_binary(tape) do
+    parameter_refs = Enum.map(parameters, & &1.ref)
+    ref = EXLA.NIF.build_tape(builder, parameter_refs, tape) |> unwrap!()
+    %Op{builder: builder, ref: ref}
+  end
+
+  @doc """
+  Annotates how `op` is split across partitions.
+
+  The sharding is either `:replicated`, where all partitions have the
+  whole `op`, or a `{tile_dimensions, devices}` tuple. `tile_dimensions`
+  has one element per dimension of `op`, with the number of tiles the
+  dimension is split into, and `devices` lists the partition each tile
+  is assigned to, in row-major order. For example, `{{1, 2}, [0, 1]}`
+  splits the last dimension of a matrix in two halves.
+
+  The sharding is used by XLA's SPMD partitioner, when computations are
+  compiled with `:num_partitions`. Parameters can be sharded with the
+  `:sharding` option in `parameter/5`.
+  """
+  def sharding(%Op{builder: builder, ref: operand}, sharding) do
+    ref = EXLA.NIF.sharding(operand, sharding) |> unwrap!()
     %Op{builder: builder, ref: ref}
   end
 
@@ -726,6 +766,100 @@ defmodule EXLA.Op do
     %Op{builder: builder, ref: ref}
   end
 
+  ## Collectives
+
+  @doc """
+  Returns the id of the replica running the computation as an
+  unsigned 32-bit scalar.
+  """
+  def replica_id(%Builder{ref: builder}) do
+    ref = EXLA.NIF.replica_id(builder) |> unwrap!()
+    %Op{builder: builder, ref: ref}
+  end
+
+  @doc """
+  Reduces `operand` across replicas with the given scalar `reduction`.
+
+  `replica_groups` is a list of lists of replica ids. The reduction
+  happens within each group. An empty list means all replicas form
+  a single group. The same applies to all collectives below.
+  """
+  def all_reduce(
+        %Op{builder: builder, ref: operand},
+        %Computation{ref: reduction},
+        replica_groups \\ []
+      ) do
+    ref = EXLA.NIF.all_reduce(operand, reduction, replica_groups) |> unwrap!()
+    %Op{builder: builder, ref: ref}
+  end
+
+  @doc """
+  Concatenates `operand` from the `shard_count` replicas in each
+  group along `dimension`.
+  """
+  def all_gather(
+        %Op{builder: builder, ref: operand},
+        dimension,
+        shard_count,
+        replica_groups \\ []
+      )
+      when is_integer(dimension) and is_integer(shard_count) do
+    ref = EXLA.NIF.all_gather(operand, dimension, shard_count, replica_groups) |> unwrap!()
+    %Op{builder: builder, ref: ref}
+  end
+
+  @doc """
+  Reduces `operand` across replicas and splits the result along
+  `dimension` into `shard_count` shards, where each replica in a
+  group receives the shard at its position in the group.
+  """
+  def reduce_scatter(
+        %Op{builder: builder, ref: operand},
+        %Computation{ref: reduction},
+        dimension,
+        shard_count,
+        replica_groups \\ []
+      )
+      when is_integer(dimension) and is_integer(shard_count) do
+    ref =
+      EXLA.NIF.reduce_scatter(operand, reduction, dimension, shard_count, replica_groups)
+      |> unwrap!()
+
+    %Op{builder: builder, ref: ref}
+  end
+
+  @doc """
+  Splits `operand` along `split_dimension` into `split_count` blocks,
+  sends each block to a replica in the group and concatenates the
+  received blocks along `concat_dimension`.
+  """
+  def all_to_all(
+        %Op{builder: builder, ref: operand},
+        split_dimension,
+        concat_dimension,
+        split_count,
+        replica_groups \\ []
+      )
+      when is_integer(split_dimension) and is_integer(concat_dimension) and
+             is_integer(split_count) do
+    ref =
+      EXLA.NIF.all_to_all(operand, split_dimension, concat_dimension, split_count, replica_groups)
+      |> unwrap!()
+
+    %Op{builder: builder, ref: ref}
+  end
+
+  @doc """
+  Sends `operand` from each source replica to its target replica,
+  given as a list of `{source, target}` pairs. Replicas which are not
+  a target receive zeros.
+  """
+  def collective_permute(%Op{builder: builder, ref: operand}, source_target_pairs)
+      when is_list(source_target_pairs) do
+    ref = EXLA.NIF.collective_permute(operand, source_target_pairs) |> unwrap!()
+    %Op{builder: builder, ref: ref}
+  end
+
   def create_token(%Builder{ref: builder}) do
     ref = EXLA.NIF.create_token(builder) |> unwrap!()
     %Op{builder: builder, ref: ref}
@@ -24,7 +24,7 @@ defmodule EXLA.MixProject do
   # Run "mix help compile.app" to learn about applications.
   def application do
     [
-      extra_applications: [:logger],
+      extra_applications: [:logger, :crypto],
       mod: {EXLA.Application, []},
       env: [
         clients: [
@@ -0,0 +1,83 @@
+defmodule EXLA.BatcherTest do
+  use ExUnit.Case, async: true
+
+  import Nx.Defn
+
+  defn affine(weights, x), do: {Nx.dot(x, weights), Nx.sum(x, axes: [1])}
+
+  @weights Nx.tensor([[1.0, 0.0], [0.0, 2.0]])
+
+  defp start_batcher(opts) do
+    opts = Keyword.merge([function: &affine/2, args: [@weights, :batch]], opts)
+    start_supervised!({EXLA.Batcher, opts})
+  end
+
+  test "batches concurrent requests and splits the results" do
+    batcher = start_batcher(max_batch_size: 8, max_wait: 100)
+
+    tasks =
+      for i <- 1..4 do
+        Task.async(fn -> EXLA.Batcher.run(batcher, [Nx.tensor([[i, i]], type: {:f, 32})]) end)
+      end
+
+    for {task, i} <- Enum.with_index(tasks, 1) do
+      {dot, sum} = Task.await(task)
+      assert dot == Nx.tensor([[i * 1.0, i * 2.0]])
+      assert sum == Nx.tensor([i * 2.0])
+    end
+
+    metrics = EXLA.Batcher.metrics(batcher)
+    assert metrics.requests == 4
+    assert metrics.batches < 4
+    assert is_integer(metrics.p50) and metrics.p50 <= metrics.p99
+  end
+
+  test "runs full batches without waiting" do
+    batcher = start_batcher(max_batch_size: 2, max_wait: 60_000, pad: false)
+    input = Nx.tensor([[1.0, 1.0], [2.0, 2.0]])
+
+    assert {dot, _sum} = EXLA.Batcher.run(batcher, [input])
+    assert dot == Nx.tensor([[1.0, 2.0], [2.0, 4.0]])
+    assert %{requests: 1, batches: 1, average_batch_size: 2.0} = EXLA.Batcher.metrics(batcher)
+  end
+
+  test "runs requests of different types and shapes in separate batches" do
+    batcher = start_batcher(max_batch_size: 8, max_wait: 100)
+
+    float = Task.async(fn -> EXLA.Batcher.run(batcher, [Nx.tensor([[1.0, 1.0]])]) end)
+    integer = Task.async(fn -> EXLA.Batcher.run(batcher, [Nx.tensor([[2, 2]])]) end)
+
+    assert {dot, _sum} = Task.await(float)
+    assert dot == Nx.tensor([[1.0, 2.0]])
+    assert {dot, _sum} = Task.await(integer)
+    assert dot == Nx.tensor([[2.0, 4.0]])
+
+    assert_raise ArgumentError, fn ->
+      EXLA.Batcher.run(batcher, [Nx.tensor([[1.0, 1.0, 1.0]])])
+    end
+
+    assert {dot, _sum} = EXLA.Batcher.run(batcher, [Nx.tensor([[3.0, 3.0]])])
+    assert dot == Nx.tensor([[3.0, 6.0]])
+  end
+
+  test "replies with exits from the function" do
+    batcher = start_batcher(function: fn _ -> exit(:boom) end, args: [:batch])
+    assert catch_exit(EXLA.Batcher.run(batcher, [Nx.tensor([[1.0, 1.0]])])) == :boom
+  end
+
+  test "raises on invalid inputs" do
+    batcher = start_batcher([])
+
+    assert_raise ArgumentError, ~r"expected 1 batched inputs, got: 2", fn ->
+      EXLA.Batcher.run(batcher, [Nx.tensor([[1.0, 1.0]]), Nx.tensor([[1.0, 1.0]])])
+    end
+
+    assert_raise ArgumentError, ~r"expected all batched inputs to have a batch axis", fn ->
+      EXLA.Batcher.run(batcher, [1.0])
+    end
+
+    assert_raise ArgumentError, ~r"expected all batched inputs to have a batch axis", fn ->
+      EXLA.Batcher.run(batcher, [Nx.tensor(1.0)])
+    end
+  end
+end
@@ -11,6 +11,18 @@ defmodule EXLA.BufferTest do
       assert is_reference(b1.ref)
     end
 
+    test "place_on_device/3" do
+      s1 = Shape.make_shape({:s, 32}, {})
+      s2 = Shape.make_shape({:f, 32}, {1024})
+
+      assert [b1, b2] = Buffer.place_on_device([{<<1::32>>, s1}, {large_binary(), s2}], client(), 0)
+      assert b1.shape == s1 and b2.shape == s2
+      assert Buffer.read(b1) == <<1::32>>
+      assert Buffer.read(b2) == large_binary()
+
+      assert Buffer.place_on_device([], client(), 0) == []
+    end
+
     test "read/2" do
       b1 =
         Buffer.place_on_device(
@@ -34,6 +46,29 @@ defmodule EXLA.BufferTest do
       end
     end
 
+    test "read/3" do
+      b1 =
+        Buffer.place_on_device(
+          <<1::32, 2::32, 3::32, 4::32>>,
+          Shape.make_shape({:s, 32}, {4}),
+          client(),
+          0
+        )
+
+      assert <<2::32, 3::32>> == Buffer.read(b1, 4, 8)
+      assert <<3::32, 4::32>> == Buffer.read(b1, 8, -1)
+      assert <<4::32>> == Buffer.read(b1, 12, 100)
+      assert <<>> == Buffer.read(b1, 16, 4)
+    end
+
+    test "place_on_device/4 keeps large binaries alive" do
+      shape = Shape.make_shape({:f, 32}, {1024})
+      b1 = Buffer.place_on_device(large_binary(), shape, client(), 0)
+      :erlang.garbage_collect()
+
+      assert Buffer.read(b1) == large_binary()
+    end
+
     test "deallocate/1" do
       b1 = Buffer.place_on_device(<<1::32>>, Shape.make_shape({:s, 32}, {}), client(), 0)
 
@@ -41,4 +76,8 @@ defmodule EXLA.BufferTest do
       assert :already_deallocated = Buffer.deallocate(b1)
     end
   end
+
+  defp large_binary do
+    for i <- 1..1024, into: <<>>, do: <<i::float-32-native>>
+  end
 end
@@ -8,4 +8,66 @@ defmodule EXLA.CLientTest do
       %{host: _} = EXLA.Client.get_supported_platforms()
     end
   end
+
+  describe "memory_stats/2" do
+    # Other tests allocate concurrently, so we only check monotonic counters
+    test "tracks buffers on the device" do
+      client = EXLAHelpers.client()
+      before = EXLA.Client.memory_stats(client, 0)
+
+      shape = EXLA.Shape.make_shape({:f, 32}, {1024})
+      buffer = EXLA.Buffer.place_on_device(<<0::32*1024>>, shape, client, 0)
+      stats = EXLA.Client.memory_stats(client, 0)
+
+      assert stats.total_allocations > before.total_allocations
+      assert stats.total_allocated_bytes >= before.total_allocated_bytes + 4096
+      assert stats.peak_allocated_bytes >= stats.allocated_bytes
+      assert stats.live_buffers >= 1
+
+      assert :ok = EXLA.Buffer.deallocate(buffer)
+    end
+
+    test "raises on unknown devices" do
+      assert_raise RuntimeError, fn -> EXLA.Client.memory_stats(EXLAHelpers.client(), 1024) end
+    end
+  end
+end
+
+defmodule EXLA.ClientMemoryBudgetTest do
+  # The budget applies to all buffers on the device, so it must not run
+  # concurrently with other tests.
+  use ExUnit.Case, async: false
+
+  alias EXLA.{BinaryBuffer, Buffer, Client, Executable, Op, Shape}
+  import EXLAHelpers
+
+  setup do
+    on_exit(fn -> Client.set_memory_budget(client(), 0) end)
+  end
+
+  test "spills least recently used buffers and restores them on use" do
+    shape = Shape.make_shape({:f, 32}, {1024})
+    exec = compile([shape], fn b, x -> Op.tuple(b, [Op.add(x, x)]) end)
+
+    ones = for _ <- 1..1024, into: <<>>, do: <<1.0::float-32-native>>
+    twos = for _ <- 1..1024, into: <<>>, do: <<2.0::float-32-native>>
+    fours = for _ <- 1..1024, into: <<>>, do: <<4.0::float-32-native>>
+
+    [a] = Executable.run(exec, [BinaryBuffer.from_binary(ones, shape)], keep_on_device: true)
+    before = Client.memory_stats(client(), 0)
+
+    :ok = Client.set_memory_budget(client(), 4096)
+    [b] = Executable.run(exec, [BinaryBuffer.from_binary(ones, shape)], keep_on_device: true)
+
+    stats = Client.memory_stats(client(), 0)
+    assert stats.memory_budget == 4096
+    assert stats.total_spills > before.total_spills
+    assert stats.spilled_buffers >= 1
+
+    # Spilled buffers are read from the host and restored when used
+    assert Buffer.read(a) == twos
+    assert [%BinaryBuffer{data: ^fours}] = Executable.run(exec, [a])
+    assert Client.memory_stats(client(), 0).total_spills > stats.total_spills
+    assert Buffer.read(b) == twos
+  end
 end
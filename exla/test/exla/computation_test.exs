@@ -0,0 +1,55 @@
+defmodule EXLA.ComputationTest do
+  use ExUnit.Case, async: true
+
+  alias EXLA.{BinaryBuffer, Builder, Computation, Executable, Op, Shape}
+  import EXLAHelpers
+
+  setup do
+    builder = Builder.new("hlo")
+    shape = Shape.make_shape({:s, 32}, {2})
+    x = Op.parameter(builder, 0, shape, "x")
+    y = Op.parameter(builder, 1, shape, "y")
+    computation = Builder.build(Op.tuple(builder, [Op.add(x, y)]))
+    {:ok, computation: computation, shape: shape}
+  end
+
+  defp run_computation(computation, shape) do
+    shapes = Computation.parameter_shapes(computation)
+    assert Enum.map(shapes, &{&1.dtype, &1.dims}) == [{{:s, 32}, {2}}, {{:s, 32}, {2}}]
+    exec = Computation.compile(computation, client(), shapes)
+    x = BinaryBuffer.from_binary(<<1::32-native, 2::32-native>>, shape)
+    y = BinaryBuffer.from_binary(<<3::32-native, 4::32-native>>, shape)
+    assert [%BinaryBuffer{data: <<4::32-native, 6::32-native>>}] = Executable.run(exec, [x, y])
+  end
+
+  test "imports HLO protos", %{computation: computation, shape: shape} do
+    imported = computation |> Computation.to_hlo_proto() |> Computation.from_hlo_proto()
+    assert %Shape{dtype: {:tuple, [%Shape{dims: {2}}]}} = imported.output_shape
+    run_computation(imported, shape)
+  end
+
+  test "imports HLO text", %{computation: computation, shape: shape} do
+    text = Computation.to_hlo_text(computation)
+    assert text =~ "HloModule"
+    run_computation(Computation.from_hlo_text(text), shape)
+  end
+
+  @tag :tmp_dir
+  test "reads HLO files", %{computation: computation, shape: shape, tmp_dir: tmp_dir} do
+    proto = Path.join(tmp_dir, "add.pb")
+    File.write!(proto, Computation.to_hlo_proto(computation))
+    run_computation(Computation.read_hlo!(proto), shape)
+
+    text = Path.join(tmp_dir, "add.hlo")
+    File.write!(text, Computation.to_hlo_text(computation))
+    run_computation(Computation.read_hlo!(text), shape)
+  end
+
+  test "raises on invalid input" do
+    assert_raise RuntimeError, ~r"Unable to parse HLO module proto", fn ->
+      Computation.from_hlo_proto("invalid")
+    end
+
+    assert_raise RuntimeError, fn -> Computation.from_hlo_text("invalid") end
+  end
+end
@@ -34,6 +34,30 @@ defmodule EXLA.Defn.APITest do
                    fn -> Nx.backend_transfer(tensor) end
     end
 
+    test "donates arguments" do
+      opts = [donate: [0], run_options: [keep_on_device: true]]
+      a = EXLA.jit(&add_two_keep_on_device/2, [Nx.tensor([1, 2]), 1], opts)
+      b = EXLA.jit(&add_two_keep_on_device/2, [a, 1], opts)
+
+      assert b |> Nx.backend_transfer() |> Nx.to_binary() == <<3::64-native, 4::64-native>>
+      assert_raise RuntimeError, ~r"deleted or donated", fn -> Nx.backend_transfer(a) end
+    end
+
+    @tag :multi_device
+    test "shards arguments across partitions" do
+      a = Nx.iota({4, 2})
+      opts = [num_partitions: 2, shard: [{0, 0}]]
+      assert EXLA.jit(&add_two_keep_on_device/2, [a, 1], opts) == Nx.add(a, 1)
+
+      b = Nx.iota({2, 4})
+      last_axis = [num_partitions: 2, shard: [{0, -1}]]
+      assert EXLA.jit(&add_two_keep_on_device/2, [b, 1], last_axis) == Nx.add(b, 1)
+
+      assert_raise ArgumentError, ~r"cannot shard argument 0", fn ->
+        EXLA.jit(&add_two_keep_on_device/2, [Nx.iota({3}), 1], opts)
+      end
+    end
+
     test "raises on invalid device_id" do
       assert_raise RuntimeError, ~r"Invalid device ordinal value \(1\)", fn ->
         EXLA.jit(&add_two_keep_on_device/2, [2, 3], device_id: 1)
@@ -41,6 +65,25 @@ defmodule EXLA.Defn.APITest do
     end
   end
 
+  describe "collectives" do
+    defn all_reduce_and_gather(t) do
+      {EXLA.Collective.all_reduce(t, op: :max), EXLA.Collective.all_gather(t, shard_count: 1)}
+    end
+
+    test "compile with a single replica" do
+      t = Nx.tensor([1, 2, 3])
+      assert all_reduce_and_gather(t) == {t, t}
+      assert Nx.Defn.jit(&all_reduce_and_gather/1, [t], compiler: Nx.Defn.Evaluator) == {t, t}
+    end
+
+    defn reduce_scatter(t), do: EXLA.Collective.reduce_scatter(t, shard_count: 2)
+
+    test "reduce_scatter falls back to the first shard of identical replicas" do
+      t = Nx.tensor([1, 2, 3, 4])
+      assert Nx.Defn.jit(&reduce_scatter/1, [t], compiler: Nx.Defn.Evaluator) == Nx.tensor([2, 4])
+    end
+  end
+
   describe "containers" do
     defn container_as_input(%Container{a: a, b: b}) do
       a * b
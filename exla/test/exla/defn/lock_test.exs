@@ -72,7 +72,7 @@ defmodule EXLA.Defn.LockeTest do
 
     assert_receive :locked
     assert_receive {:on_unlock, lock_pid}
-    assert lock_pid == Process.whereis(EXLA.Defn.Lock)
+    assert lock_pid == Process.whereis(L.shard(config.test))
 
     task3 =
       Task.async(fn ->
@@ -101,7 +101,7 @@ defmodule EXLA.Defn.LockeTest do
     ref = L.transfer(ref, fn -> send(parent, {:transfer, self()}) end, task1.pid)
 
     assert_receive {:transfer, lock_pid}
-    assert lock_pid == Process.whereis(EXLA.Defn.Lock)
+    assert lock_pid == Process.whereis(L.shard(config.test))
 
     task2 =
       Task.async(fn ->
@@ -131,4 +131,86 @@ defmodule EXLA.Defn.LockeTest do
     send(task3.pid, :done)
     assert Task.await(task3)
   end
+
+  test "unlocks transferred locks while their holder is alive", config do
+    parent = self()
+
+    task1 =
+      Task.async(fn ->
+        assert_receive :done
+      end)
+
+    ref = L.lock(config.test)
+    ref = L.transfer(ref, fn -> :ok end, task1.pid)
+
+    task2 =
+      Task.async(fn ->
+        L.lock(config.test)
+        send(parent, :locked)
+      end)
+
+    refute_receive :locked, 100
+    assert L.unlock(ref)
+    assert_receive :locked
+    assert Task.await(task2)
+
+    send(task1.pid, :done)
+    assert Task.await(task1)
+  end
+
+  test "shares a key up to the given concurrency", config do
+    parent = self()
+    ref1 = L.lock(config.test, 2)
+    ref2 = L.lock(config.test, 2)
+
+    task =
+      Task.async(fn ->
+        L.lock(config.test, 2)
+        send(parent, :locked)
+      end)
+
+    refute_receive :locked, 100
+    :ok = L.unlock(ref1)
+    assert_receive :locked
+    assert Task.await(task)
+    :ok = L.unlock(ref2)
+  end
+
+  test "exclusive locks wait for shared holders and block new ones", config do
+    parent = self()
+    shared = L.lock(config.test, 4)
+
+    exclusive =
+      Task.async(fn ->
+        L.lock(config.test)
+        send(parent, :exclusive)
+        assert_receive :done
+      end)
+
+    refute_receive :exclusive, 100
+
+    # Queued behind the exclusive lock, even though there is room
+    task =
+      Task.async(fn ->
+        L.lock(config.test, 4)
+        send(parent, :shared)
+      end)
+
+    refute_receive :shared, 100
+    :ok = L.unlock(shared)
+    assert_receive :exclusive
+    refute_receive :shared, 100
+
+    send(exclusive.pid, :done)
+    assert Task.await(exclusive)
+    assert_receive :shared
+    assert Task.await(task)
+  end
+
+  test "spreads keys across shards" do
+    shards = for key <- 1..100, uniq: true, do: L.shard(key)
+    assert length(shards) <= System.schedulers_online()
+    assert L.shard(1) == L.shard(1)
+    assert Enum.all?(shards, &is_pid(Process.whereis(&1)))
+  end
 end
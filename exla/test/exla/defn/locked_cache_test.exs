@@ -88,3 +88,56 @@ defmodule EXLA.Defn.LockedCacheTest do
     end)
   end
 end
+
+defmodule EXLA.Defn.LockedCacheEvictionTest do
+  # Limits apply to the whole cache, so tests cannot run concurrently
+  use ExUnit.Case, async: false
+
+  alias EXLA.Defn.LockedCache, as: LC
+
+  setup do
+    previous = Application.get_env(:exla, :defn_cache)
+
+    on_exit(fn ->
+      if previous,
+        do: Application.put_env(:exla, :defn_cache, previous),
+        else: Application.delete_env(:exla, :defn_cache)
+    end)
+  end
+
+  test "evicts least recently used entries over max entries", config do
+    Application.put_env(:exla, :defn_cache, max_entries: 2)
+    [k1, k2, k3] = for i <- 1..3, do: {config.test, i}
+    %{hits: hits, evictions: evictions} = LC.stats()
+
+    assert LC.run(k1, fn -> {:inner, 1} end) == {:inner, 1}
+    assert LC.run(k2, fn -> {:inner, 2} end) == {:inner, 2}
+    assert LC.run(k1, fn -> flunk() end) == {nil, 1}
+    assert LC.run(k3, fn -> {:inner, 3} end) == {:inner, 3}
+    :ok = LC.sync()
+
+    assert LC.fetch(k1) == {:ok, 1}
+    assert LC.fetch(k2) == :error
+    assert LC.fetch(k3) == {:ok, 3}
+
+    stats = LC.stats()
+    assert stats.entries == 2
+    assert stats.hits == hits + 1
+    assert stats.evictions > evictions
+  end
+
+  test "evicts least recently used entries over max bytes", config do
+    Application.put_env(:exla, :defn_cache, max_bytes: 100)
+    [k1, k2] = for i <- 1..2, do: {config.test, i}
+
+    assert LC.run(k1, fn -> {:inner, 1, 60} end) == {:inner, 1}
+    :ok = LC.sync()
+    assert LC.fetch(k1) == {:ok, 1}
+
+    assert LC.run(k2, fn -> {:inner, 2, 60} end) == {:inner, 2}
+    :ok = LC.sync()
+    assert LC.fetch(k1) == :error
+    assert LC.fetch(k2) == {:ok, 2}
+    assert LC.stats().bytes <= 100
+  end
+end
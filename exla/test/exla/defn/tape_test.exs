@@ -0,0 +1,57 @@
+defmodule EXLA.Defn.TapeTest do
+  use ExUnit.Case, async: true
+
+  import Nx.Defn
+  alias EXLA.Defn.Tape
+  alias Nx.Defn.Expr
+
+  describe "encode" do
+    test "encodes supported operations" do
+      a = Expr.parameter(:root, {:f, 32}, {2, 3}, 0)
+      b = Expr.parameter(:root, {:s, 64}, {3}, 1)
+      expr = {Nx.sum(Nx.exp(a) * b + 1, axes: [1]), Nx.dot(a, Nx.transpose(a))}
+
+      assert {:ok, tape} = Tape.encode(expr, %{0 => 0, 1 => 1}, :highest)
+      assert is_binary(tape)
+    end
+
+    test "returns error on unsupported operations" do
+      a = Expr.parameter(:root, {:f, 32}, {2, 3}, 0)
+      assert Tape.encode(Nx.sort(a), %{0 => 0}, :highest) == :error
+      assert Tape.encode({Nx.exp(a), Nx.exp(Nx.sort(a))}, %{0 => 0}, :highest) == :error
+    end
+  end
+
+  describe "build" do
+    defn tape(a, b) do
+      c = Nx.select(a > b, Nx.exp(a), Nx.negate(b))
+      {Nx.sum(c, axes: [1], keep_axes: true), Nx.reduce_max(a * 2 - b), c <= 0 or a == b}
+    end
+
+    defn mixed(a, b), do: Nx.sort(a + b)
+
+    test "matches the evaluator" do
+      a = Nx.tensor([[1.0, -2.0, 3.0], [4.0, 5.0, -6.0]])
+      b = Nx.tensor([2, 2, 2])
+      {sum, max, pred} = EXLA.jit(&tape/2, [a, b])
+      {e_sum, e_max, e_pred} = Nx.Defn.jit(&tape/2, [a, b], compiler: Nx.Defn.Evaluator)
+
+      assert Nx.all_close(sum, e_sum) == Nx.tensor(1, type: {:u, 8})
+      assert max == e_max
+      assert pred == e_pred
+    end
+
+    test "falls back to building each operation" do
+      a = Nx.tensor([3, 1, 2])
+      assert EXLA.jit(&mixed/2, [a, 1]) == Nx.tensor([2, 3, 4])
+    end
+
+    test "raises on invalid tapes" do
+      builder = EXLA.Builder.new("tape")
+
+      assert_raise RuntimeError, ~r"Tape ended unexpectedly", fn ->
+        EXLA.Op.from_tape(builder, [], <<0>>)
+      end
+    end
+  end
+end
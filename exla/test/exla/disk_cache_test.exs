@@ -0,0 +1,83 @@
+defmodule EXLA.DiskCacheTest do
+  use ExUnit.Case, async: false
+
+  alias EXLA.{BinaryBuffer, DiskCache, Executable, Op}
+  import EXLAHelpers
+
+  @moduletag :tmp_dir
+
+  setup %{tmp_dir: tmp_dir} do
+    previous = Application.get_env(:exla, :disk_cache)
+    Application.put_env(:exla, :disk_cache, path: tmp_dir, max_size: 100)
+
+    on_exit(fn ->
+      if previous,
+        do: Application.put_env(:exla, :disk_cache, previous),
+        else: Application.delete_env(:exla, :disk_cache)
+    end)
+
+    :ok
+  end
+
+  test "is disabled without a path" do
+    Application.delete_env(:exla, :disk_cache)
+    assert DiskCache.put("disabled", "data") == :error
+    assert DiskCache.fetch("disabled") == :error
+  end
+
+  test "reads and writes entries" do
+    %{hits: hits, misses: misses} = DiskCache.stats()
+    key = DiskCache.key(:reads_and_writes)
+
+    assert DiskCache.fetch(key) == :error
+    assert DiskCache.put(key, "data") == :ok
+    assert DiskCache.fetch(key) == {:ok, "data"}
+
+    assert %{hits: new_hits, misses: new_misses, entries: 1, size: 4} = DiskCache.stats()
+    assert new_hits == hits + 1
+    assert new_misses == misses + 1
+  end
+
+  test "evicts least recently used entries over the limit", %{tmp_dir: tmp_dir} do
+    assert DiskCache.put("first", :binary.copy("a", 60)) == :ok
+    File.touch!(Path.join(tmp_dir, "first"), {{2000, 1, 1}, {0, 0, 0}})
+    assert DiskCache.put("second", :binary.copy("b", 60)) == :ok
+    DiskCache.sync()
+
+    assert DiskCache.fetch("first") == :error
+    assert {:ok, _} = DiskCache.fetch("second")
+  end
+
+  # Host executables cannot be serialized, so the cache is skipped
+  @tag platform: :host
+  test "compiles without the cache on host" do
+    stats = DiskCache.stats()
+
+    for _ <- 1..2 do
+      exec = compile([], fn b -> Op.tuple(b, [Op.constant_r0(b, 1, {:s, 32})]) end)
+      assert [%BinaryBuffer{data: <<1::32-native>>}] = Executable.run(exec, [])
+    end
+
+    assert DiskCache.stats() == stats
+  end
+
+  @tag platform: :tpu
+  test "loads executables from disk once they are evicted from memory", %{tmp_dir: tmp_dir} do
+    Application.put_env(:exla, :disk_cache, path: tmp_dir)
+
+    # Executables are not kept in memory, so every jit compiles again
+    no_memory_cache = fn _key, fun ->
+      {nil, value, _size} = fun.()
+      {nil, value}
+    end
+
+    options = [{EXLA, {&EXLA.Defn.LockedCache.run/2, no_memory_cache}}]
+    %{hits: hits} = DiskCache.stats()
+
+    assert EXLA.jit(&Nx.add(&1, 1), [Nx.tensor(1)], options) == Nx.tensor(2)
+    assert DiskCache.stats().hits == hits
+
+    assert EXLA.jit(&Nx.add(&1, 1), [Nx.tensor(1)], options) == Nx.tensor(2)
+    assert DiskCache.stats().hits == hits + 1
+  end
+end
@@ -19,6 +19,33 @@ defmodule EXLA.ExecutableTest do
     end
   end
 
+  describe "compile" do
+    test "does not leak compilation messages" do
+      exec = compile([], fn b -> Op.tuple(b, [Op.constant_r0(b, 1, {:s, 32})]) end)
+      assert %Executable{} = exec
+      refute_received _
+    end
+
+    test "succeeds concurrently" do
+      tasks =
+        for i <- 1..4 do
+          Task.async(fn ->
+            exec = compile([], fn b -> Op.tuple(b, [Op.constant_r0(b, i, {:s, 32})]) end)
+            Executable.run(exec, [])
+          end)
+        end
+
+      for {task, i} <- Enum.with_index(tasks, 1) do
+        assert [%BinaryBuffer{data: <<^i::32-native>>}] = Task.await(task)
+      end
+    end
+
+    test "estimates the size of the compiled code" do
+      exec = compile([], fn b -> Op.tuple(b, [Op.constant_r0(b, 1, {:s, 32})]) end)
+      assert Executable.size_bytes(exec) > 0
+    end
+  end
+
   describe "run" do
     test "succeeds with no inputs and default options" do
       assert [%BinaryBuffer{data: <<1::32-native>>}] =
@@ -66,6 +93,20 @@ defmodule EXLA.ExecutableTest do
       assert [%BinaryBuffer{data: <<4::32-native>>}] = Executable.run(exec, [t3, t3])
     end
 
+    test "reads outputs which outlive their buffers" do
+      shape = Shape.make_shape({:f, 32}, {1024})
+      t1 = BinaryBuffer.from_binary(floats(1..1024), shape)
+      exec = compile([shape], fn b, x -> Op.tuple(b, [Op.add(x, x)]) end)
+
+      assert [t2 = %Buffer{}] = Executable.run(exec, [t1], keep_on_device: true)
+      binary = Buffer.read(t2)
+      assert Buffer.read(t2, 4, 8) == binary_part(binary, 4, 8)
+
+      :ok = Buffer.deallocate(t2)
+      :erlang.garbage_collect()
+      assert binary == floats(2..2048//2)
+    end
+
     test "succeeds with mixed data" do
       t1 = Buffer.place_on_device(<<1::32-native>>, Shape.make_shape({:s, 32}, {}), client(), 0)
       t2 = BinaryBuffer.from_binary(<<2::32-native>>, Shape.make_shape({:s, 32}, {}))
@@ -96,6 +137,133 @@ defmodule EXLA.ExecutableTest do
       assert <<3::32-native>> == Buffer.read(c)
     end
 
+    test "succeeds with many asynchronous runs in flight" do
+      t1 = BinaryBuffer.from_binary(<<1::32-native>>, Shape.make_shape({:s, 32}, {}))
+      exec = compile([t1.shape], fn b, x -> Op.tuple(b, [Op.add(x, x)]) end)
+
+      refs = for _ <- 1..8, do: Executable.run_async(exec, [t1])
+      assert Enum.all?(refs, &is_reference/1)
+
+      for ref <- refs do
+        assert [%BinaryBuffer{data: <<2::32-native>>}] = Executable.await(ref, exec)
+      end
+    end
+
+    test "succeeds asynchronously with keep_on_device true" do
+      t1 = BinaryBuffer.from_binary(<<1::32-native>>, Shape.make_shape({:s, 32}, {}))
+      exec = compile([t1.shape], fn b, x -> Op.tuple(b, [Op.add(x, x)]) end)
+
+      ref = Executable.run_async(exec, [t1], keep_on_device: true)
+      assert [a = %Buffer{}] = Executable.await(ref, exec)
+      assert Buffer.read(a) == <<2::32-native>>
+    end
+
+    test "donates aliased binaries without changing them" do
+      t1 = BinaryBuffer.from_binary(<<1::32-native>>, Shape.make_shape({:s, 32}, {}))
+      exec = compile([t1.shape], fn b, x -> Op.tuple(b, [Op.add(x, x)]) end, aliases: [{0, 0}])
+
+      assert [%BinaryBuffer{data: <<2::32-native>>}] = Executable.run(exec, [t1])
+      assert [%BinaryBuffer{data: <<2::32-native>>}] = Executable.run(exec, [t1])
+      assert t1.data == <<1::32-native>>
+    end
+
+    test "donates aliased buffers and invalidates them" do
+      t1 = Buffer.place_on_device(<<1::32-native>>, Shape.make_shape({:s, 32}, {}), client(), 0)
+      exec = compile([t1.shape], fn b, x -> Op.tuple(b, [Op.add(x, x)]) end, aliases: [{0, 0}])
+
+      assert [t2 = %Buffer{}] = Executable.run(exec, [t1], keep_on_device: true)
+      assert [%BinaryBuffer{data: <<4::32-native>>}] = Executable.run(exec, [t2])
+
+      assert_raise RuntimeError, ~r"deleted or donated", fn -> Buffer.read(t1) end
+      assert_raise RuntimeError, ~r"deleted or donated", fn -> Buffer.read(t2) end
+    end
+
+    test "donates copies of buffers placed from large binaries" do
+      shape = Shape.make_shape({:f, 32}, {1024})
+      binary = for i <- 1..1024, into: <<>>, do: <<i::float-32-native>>
+      t1 = Buffer.place_on_device(binary, shape, client(), 0)
+      exec = compile([shape], fn b, x -> Op.tuple(b, [Op.add(x, x)]) end, aliases: [{0, 0}])
+
+      assert [%BinaryBuffer{}] = Executable.run(exec, [t1])
+      assert binary == for(i <- 1..1024, into: <<>>, do: <<i::float-32-native>>)
+    end
+
+    @tag :multi_device
+    test "succeeds with replicas" do
+      shape = Shape.make_shape({:s, 32}, {})
+      count = client().device_count
+      exec = compile([shape], fn b, x -> Op.tuple(b, [Op.add(x, x)]) end, num_replicas: count)
+      assert exec.device_id == -1
+
+      args = for i <- 1..count, do: [BinaryBuffer.from_binary(<<i::32-native>>, shape)]
+      results = Executable.run(exec, args)
+      assert length(results) == count
+
+      for {[%BinaryBuffer{data: data}], i} <- Enum.with_index(results, 1) do
+        assert data == <<2 * i::32-native>>
+      end
+
+      results = Executable.run(exec, args, keep_on_device: true)
+      assert results |> Enum.map(fn [buffer] -> buffer.device_id end) |> Enum.uniq() |> length() == count
+    end
+
+    @tag :multi_device
+    test "succeeds with collectives across replicas" do
+      shape = Shape.make_shape({:s, 32}, {})
+      count = client().device_count
+
+      exec =
+        compile(
+          [shape],
+          fn b, x ->
+            sub = EXLA.Builder.new(b, "add")
+            l = Op.parameter(sub, 0, shape, "l")
+            r = Op.parameter(sub, 1, shape, "r")
+            Op.tuple(b, [Op.all_reduce(x, EXLA.Builder.build(Op.add(l, r)))])
+          end,
+          num_replicas: count
+        )
+
+      args = for i <- 1..count, do: [BinaryBuffer.from_binary(<<i::32-native>>, shape)]
+      sum = div(count * (count + 1), 2)
+
+      for [%BinaryBuffer{data: data}] <- Executable.run(exec, args) do
+        assert data == <<sum::32-native>>
+      end
+    end
+
+    @tag :multi_device
+    test "succeeds with reduce scatter across replicas" do
+      count = client().device_count
+      shape = Shape.make_shape({:s, 32}, {count})
+      scalar = Shape.make_shape({:s, 32}, {})
+
+      exec =
+        compile(
+          [shape],
+          fn b, x ->
+            sub = EXLA.Builder.new(b, "add")
+            l = Op.parameter(sub, 0, scalar, "l")
+            r = Op.parameter(sub, 1, scalar, "r")
+            Op.tuple(b, [Op.reduce_scatter(x, EXLA.Builder.build(Op.add(l, r)), 0, count)])
+          end,
+          num_replicas: count
+        )
+
+      # Replica i holds [i, 2 * i, 3 * i, ...], so the sum at position j is sum * (j + 1)
+      args =
+        for i <- 1..count do
+          data = for j <- 1..count, into: <<>>, do: <<i * j::32-native>>
+          [BinaryBuffer.from_binary(data, shape)]
+        end
+
+      sum = div(count * (count + 1), 2)
+
+      for {[%BinaryBuffer{data: data}], j} <- Enum.with_index(Executable.run(exec, args), 1) do
+        assert data == <<sum * j::32-native>>
+      end
+    end
+
     @tag :multi_device
     test "succeeds with device set" do
       t1 = BinaryBuffer.from_binary(<<1::32-native>>, Shape.make_shape({:s, 32}, {}))
@@ -184,6 +352,76 @@ defmodule EXLA.ExecutableFeedTest do
       assert [a = %Buffer{}] = Task.await(res)
       assert Buffer.read(a) == <<0::32-native>>
     end
+
+    test "successfully sends to device from a queue" do
+      shape = Shape.make_shape({:s, 32}, {})
+      queue = Client.start_infeed_queue(client(), 0, 2)
+
+      # Both entries are queued before the computation starts
+      assert :ok = Client.enqueue_infeed(queue, [{<<1::32-native>>, shape}])
+      assert :ok = Client.enqueue_infeed(queue, [{<<2::32-native>>, shape}])
+
+      assert res =
+               Task.async(fn ->
+                 run([], [], fn b ->
+                   token = Op.create_token(b)
+                   first = Op.infeed(token, shape)
+                   second = Op.infeed(Op.get_tuple_element(first, 1), shape)
+                   x = Op.get_tuple_element(first, 0)
+                   y = Op.get_tuple_element(second, 0)
+                   Op.tuple(b, [Op.subtract(x, y)])
+                 end)
+               end)
+
+      assert [%BinaryBuffer{data: <<-1::32-signed-native>>}] = Task.await(res)
+    end
+
+    test "reads outfeed in batches with a reader" do
+      s32 = Shape.make_shape({:s, 32}, {})
+      ref = make_ref()
+
+      reader =
+        Client.start_outfeed_reader(client(), 0, [{1, [s32]}, {2, [s32, s32]}], self(), ref,
+          capacity: 2,
+          max_batch: 2
+        )
+
+      assert res =
+               Task.async(fn ->
+                 run([], [], fn b ->
+                   outfeed = fn values, token -> Enum.reduce(values, token, &Op.outfeed/2) end
+
+                   token = Op.create_token(b)
+                   flag = &Op.constant_r0(b, &1, {:u, 16})
+                   value = &Op.constant_r0(b, &1, {:s, 32})
+                   token = outfeed.([flag.(1), value.(1)], token)
+                   token = outfeed.([flag.(2), value.(2), value.(3)], token)
+                   token = outfeed.([flag.(1), value.(4)], token)
+                   _token = outfeed.([flag.(0)], token)
+                   Op.tuple(b, [value.(0)])
+                 end)
+               end)
+
+      assert receive_outfeed(reader, ref) == [
+               {1, [<<1::32-native>>]},
+               {2, [<<2::32-native>>, <<3::32-native>>]},
+               {1, [<<4::32-native>>]}
+             ]
+
+      assert [%BinaryBuffer{}] = Task.await(res)
+    end
+  end
+
+  defp receive_outfeed(reader, ref) do
+    receive do
+      {^ref, {:outfeed, messages}} ->
+        assert length(messages) <= 2
+        :ok = Client.ack_outfeed(reader)
+        messages ++ receive_outfeed(reader, ref)
+
+      {^ref, :done} ->
+        []
+    end
   end
 
   defp from_outfeed(client, device_id, shape) do
@@ -194,4 +432,6 @@ defmodule EXLA.ExecutableFeedTest do
       {^ref, msg} -> msg
     end
   end
+
+  defp floats(range), do: for(i <- range, into: <<>>, do: <<i::float-32-native>>)
 end
@@ -3,6 +3,32 @@ defmodule EXLA.OpTest do
 
   alias EXLA.{Builder, Shape, Op}
 
+  test "collectives successfully create ops" do
+    builder = Builder.new("test")
+    x = Op.parameter(builder, 0, Shape.make_shape({:f, 32}, {4, 2}), "x")
+
+    sub = Builder.new(builder, "add")
+    a = Op.parameter(sub, 0, Shape.make_shape({:f, 32}, {}), "a")
+    b = Op.parameter(sub, 1, Shape.make_shape({:f, 32}, {}), "b")
+    add = Builder.build(Op.add(a, b))
+
+    assert %Shape{dims: {4, 2}} = Op.get_shape(Op.all_reduce(x, add, [[0, 1]]))
+    assert %Shape{dims: {8, 2}} = Op.get_shape(Op.all_gather(x, 0, 2, [[0, 1]]))
+    assert %Shape{dims: {2, 2}} = Op.get_shape(Op.reduce_scatter(x, add, 0, 2, [[1, 0]]))
+    assert %Shape{dims: {2, 4}} = Op.get_shape(Op.all_to_all(x, 0, 1, 2, [[0, 1]]))
+    assert %Shape{dims: {4, 2}} = Op.get_shape(Op.collective_permute(x, [{0, 1}, {1, 0}]))
+    assert %Shape{dims: {}, dtype: {:u, 32}} = Op.get_shape(Op.replica_id(builder))
+  end
+
+  test "sharding successfully annotates ops" do
+    builder = Builder.new("test")
+    shape = Shape.make_shape({:f, 32}, {4, 2})
+    x = Op.parameter(builder, 0, shape, "x", sharding: {{2, 1}, [0, 1]})
+
+    assert %Shape{dims: {4, 2}} = Op.get_shape(x)
+    assert %Shape{dims: {4, 2}} = Op.get_shape(Op.sharding(Op.add(x, x), :replicated))
+  end
+
   test "parameter/4 successfully creates op" do
     builder = Builder.new("test")
     shape = Shape.make_shape({:s, 32}, {1, 1})
@@ -10,6 +10,7 @@ defmodule EXLAHelpers do
   It expects a list of shapes which will be given as parameters.
   """
   def compile(shapes, fun, opts \\ []) do
+    {aliases, opts} = Keyword.pop(opts, :aliases, [])
     builder = EXLA.Builder.new("test")
 
     {params, _} =
@@ -19,7 +20,7 @@ defmodule EXLAHelpers do
 
     fun
     |> apply([builder | params])
-    |> EXLA.Builder.build()
+    |> EXLA.Builder.build(aliases: aliases)
     |> EXLA.Computation.compile(client(), shapes, opts)
   end
 
@@ -0,0 +1,39 @@
+# Runs matrix multiplications from several processes at once under
+# different thread settings. Each caller runs at the reported ips, so
+# the total throughput is the ips times the number of callers.
+#
+#     mix run bench/threads.exs
+#
+Nx.default_backend(Torchx.Backend)
+
+size = 512
+a = Nx.random_uniform({size, size}, type: {:f, 32})
+b = Nx.random_uniform({size, size}, type: {:f, 32})
+cores = Torchx.num_threads()
+
+settings = %{
+  "all cores" => [threads: cores, split: false],
+  "1 thread" => [threads: 1, split: false],
+  "split cores" => [threads: cores, split: true]
+}
+
+for parallel <- Enum.uniq([1, 2, 4, System.schedulers_online()]) do
+  IO.puts("\n## #{parallel} concurrent callers\n")
+
+  benches =
+    for {name, [threads: threads, split: split]} <- settings, into: %{} do
+      configure = fn input ->
+        Torchx.set_num_threads(threads, split: split)
+        input
+      end
+
+      {name, {fn -> Nx.dot(a, b) end, before_scenario: configure}}
+    end
+
+  Benchee.run(
+    benches,
+    parallel: parallel,
+    warmup: 1,
+    time: 5
+  )
+end
@@ -1,5 +1,12 @@
 #include <torch/torch.h>
+#include <torch/csrc/jit/ir/irparser.h>
+#include <torch/csrc/jit/runtime/graph_executor.h>
+#include <atomic>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "nx_nif_utils.hpp"
 
@@ -157,6 +164,28 @@ NIF(from_blob)
   if (blob.size / dtype_sizes[type_atom] < elem_count(shape))
     return nx::nif::error(env, "Binary size is too small for the requested shape");
 
+  // CPU tensors alias the binary memory instead of copying it.
+  // Binaries are immutable and may be shared with other terms, so
+  // tensors created here must never be written in place, neither
+  // directly nor as the out tensor of the out variants below.
+  if ((torch::DeviceType)device[0] == torch::kCPU)
+  {
+    // Copying a refc binary into another env only increments its
+    // reference count, which keeps the memory alive until the env
+    // is freed. The env is shared with the storage deleter, so it is
+    // freed once the storage is, or on return if from_blob throws.
+    std::shared_ptr<ErlNifEnv> blob_env(enif_alloc_env(), enif_free_env);
+    ERL_NIF_TERM blob_term = enif_make_copy(blob_env.get(), argv[0]);
+    ErlNifBinary kept;
+    enif_inspect_binary(blob_env.get(), blob_term, &kept);
+
+    // Unaligned binaries, such as some sub-binaries, are still copied
+    if ((uintptr_t)kept.data % dtype_sizes[type_atom] == 0)
+    {
+      TENSOR(torch::from_blob(kept.data, shape, [blob_env](void *) mutable { blob_env.reset(); }, OPTS(type, device)));
+    }
+  }
+
   // Clone here to copy data from blob, which will be GCed.
   TENSOR(torch::clone(torch::from_blob(blob.data, shape, OPTS(type, device))));
 }
@@ -570,6 +599,76 @@ UNARY_OP(erf)
 UNARY_OP(erfc)
 UNARY_OP2(erf_inv, erfinv)
 
+/* Out Ops */
+
+// Out variants write the result into the first tensor instead of
+// allocating a new one, which is how in-place operations are done
+// when it is also one of the operands. The out tensor must not be
+// referenced anywhere else, nor created from a binary with from_blob.
+
+#define BINARY_OP_OUT(OP) BINARY_OP_OUT2(OP, OP)
+
+#define BINARY_OP_OUT2(OP, NATIVE_OP)            \
+  NIF(OP##_out)                                  \
+  {                                              \
+    TENSOR_PARAM(0, out);                        \
+    TENSOR_PARAM(1, a);                          \
+    TENSOR_PARAM(2, b);                          \
+                                                 \
+    TENSOR(torch::NATIVE_OP##_out(*out, *a, *b)); \
+  }
+
+#define UNARY_OP_OUT(OP) UNARY_OP_OUT2(OP, OP)
+
+#define UNARY_OP_OUT2(OP, NATIVE)           \
+  NIF(OP##_out)                             \
+  {                                         \
+    TENSOR_PARAM(0, out);                   \
+    TENSOR_PARAM(1, a);                     \
+    TENSOR(torch::NATIVE##_out(*out, *a));  \
+  }
+
+BINARY_OP_OUT(add)
+BINARY_OP_OUT(subtract)
+BINARY_OP_OUT(multiply)
+BINARY_OP_OUT(divide)
+BINARY_OP_OUT(remainder)
+BINARY_OP_OUT2(power, pow)
+BINARY_OP_OUT(atan2)
+BINARY_OP_OUT(min)
+BINARY_OP_OUT(max)
+
+UNARY_OP_OUT(abs)
+UNARY_OP_OUT(ceil)
+UNARY_OP_OUT(floor)
+UNARY_OP_OUT2(negate, negative)
+UNARY_OP_OUT(round)
+UNARY_OP_OUT(sign)
+UNARY_OP_OUT(exp)
+UNARY_OP_OUT(expm1)
+UNARY_OP_OUT(sqrt)
+UNARY_OP_OUT(rsqrt)
+UNARY_OP_OUT(log)
+UNARY_OP_OUT(log1p)
+UNARY_OP_OUT(bitwise_not)
+UNARY_OP_OUT2(logistic, sigmoid)
+
+UNARY_OP_OUT(sin)
+UNARY_OP_OUT(asin)
+UNARY_OP_OUT(sinh)
+UNARY_OP_OUT(asinh)
+UNARY_OP_OUT(cos)
+UNARY_OP_OUT(acos)
+UNARY_OP_OUT(cosh)
+UNARY_OP_OUT(acosh)
+UNARY_OP_OUT(tan)
+UNARY_OP_OUT(atan)
+UNARY_OP_OUT(tanh)
+UNARY_OP_OUT(atanh)
+UNARY_OP_OUT(erf)
+UNARY_OP_OUT(erfc)
+UNARY_OP_OUT2(erf_inv, erfinv)
+
 NIF(triangular_solve)
 {
   TENSOR_PARAM(0, a);
@@ -743,6 +842,87 @@ NIF(lu)
   TENSOR_TUPLE_3(plu);
 }
 
+/* TorchScript */
+
+ErlNifResourceType *GRAPH_TYPE;
+
+// A graph lowered from a defn expression by Torchx.Defn. The executor
+// optimizes and fuses the graph for the inputs it is first run with.
+struct Graph
+{
+  std::shared_ptr<torch::jit::Graph> graph;
+  torch::jit::GraphExecutor executor;
+
+  Graph(std::shared_ptr<torch::jit::Graph> graph) : graph(graph), executor(graph, "torchx") {}
+};
+
+NIF(jit_compile)
+{
+  BINARY_PARAM(0, ir);
+
+  try
+  {
+    auto graph = std::make_shared<torch::jit::Graph>();
+    torch::jit::parseIR(std::string((const char *)ir.data, ir.size), graph.get());
+
+    Graph *graphPtr = (Graph *)enif_alloc_resource(GRAPH_TYPE, sizeof(Graph));
+    if (graphPtr == NULL)
+      return enif_make_badarg(env);
+
+    new (graphPtr) Graph(graph);
+
+    ERL_NIF_TERM ret = enif_make_resource(env, graphPtr);
+    enif_release_resource(graphPtr);
+
+    return nx::nif::ok(env, ret);
+  }
+  CATCH()
+  catch (std::exception &error)
+  {
+    std::ostringstream msg;
+    msg << error.what() << " in NIF." << __func__ << "/" << argc;
+    return nx::nif::error(env, msg.str().c_str());
+  }
+}
+
+NIF(jit_run)
+{
+  Graph *graph;
+  if (!enif_get_resource(env, argv[0], GRAPH_TYPE, (void **)&graph))
+    return nx::nif::error(env, "Unable to get graph param.");
+
+  LIST_PARAM(1, std::vector<torch::Tensor>, tensors);
+
+  try
+  {
+    torch::NoGradGuard no_grad;
+    torch::jit::Stack stack(tensors.begin(), tensors.end());
+    graph->executor.run(stack);
+
+    std::vector<ERL_NIF_TERM> res_list;
+    for (const c10::IValue &value : stack)
+      res_list.push_back(create_tensor_resource(env, value.toTensor().contiguous()));
+
+    return nx::nif::ok(env, enif_make_list_from_array(env, res_list.data(), res_list.size()));
+  }
+  CATCH()
+  catch (std::exception &error)
+  {
+    std::ostringstream msg;
+    msg << error.what() << " in NIF." << __func__ << "/" << argc;
+    return nx::nif::error(env, msg.str().c_str());
+  }
+}
+
+void free_graph(ErlNifEnv *env, void *obj)
+{
+  Graph *graph = reinterpret_cast<Graph *>(obj);
+  if (graph != nullptr) {
+    graph->~Graph();
+    graph = nullptr;
+  }
+}
+
 void free_tensor(ErlNifEnv *env, void *obj)
 {
   torch::Tensor* tensor = reinterpret_cast<torch::Tensor*>(obj);
@@ -752,6 +932,9 @@ void free_tensor(ErlNifEnv *env, void *obj)
   }
 }
 
+ErlNifResourceType *HINTS_TYPE;
+void hint_down(ErlNifEnv *env, void *obj, ErlNifPid *pid, ErlNifMonitor *mon);
+
 static int
 open_resource_type(ErlNifEnv *env)
 {
@@ -761,6 +944,15 @@ open_resource_type(ErlNifEnv *env)
   TENSOR_TYPE = enif_open_resource_type(env, NULL, name, free_tensor, flags, NULL);
   if (TENSOR_TYPE == NULL)
     return -1;
+
+  GRAPH_TYPE = enif_open_resource_type(env, NULL, "Graph", free_graph, flags, NULL);
+  if (GRAPH_TYPE == NULL)
+    return -1;
+
+  ErlNifResourceTypeInit hints_init = {NULL, NULL, hint_down};
+  HINTS_TYPE = enif_open_resource_type_x(env, "ThreadHints", &hints_init, flags, NULL);
+  if (HINTS_TYPE == NULL)
+    return -1;
   return 0;
 }
 
@@ -775,11 +967,398 @@ int upgrade(ErlNifEnv *env, void **priv_data, void **old_priv_data, ERL_NIF_TERM
   return 0;
 }
 
+/* Tape */
+
+// A tape runs a list of operations in a single call, without creating
+// resources for intermediate results. Each operation is a tuple with
+// the name of the Torchx function, the indexes of its tensor operands
+// and its remaining arguments. Operands index the given tensors followed
+// by the results of the previous operations. Only the results at the
+// output indexes are returned.
+
+#define TAPE_UNARY(OP, NATIVE) \
+  {#OP, [](const torch::Tensor &a) { return torch::NATIVE(a); }}
+
+#define TAPE_BINARY(OP, NATIVE) \
+  {#OP, [](const torch::Tensor &a, const torch::Tensor &b) { return torch::NATIVE(a, b); }}
+
+std::map<const std::string, std::function<torch::Tensor(const torch::Tensor &)>> tape_unary = {
+    TAPE_UNARY(abs, abs), TAPE_UNARY(ceil, ceil), TAPE_UNARY(floor, floor),
+    TAPE_UNARY(negate, negative), TAPE_UNARY(round, round), TAPE_UNARY(sign, sign),
+    TAPE_UNARY(exp, exp), TAPE_UNARY(expm1, expm1), TAPE_UNARY(sqrt, sqrt),
+    TAPE_UNARY(rsqrt, rsqrt), TAPE_UNARY(log, log), TAPE_UNARY(log1p, log1p),
+    TAPE_UNARY(bitwise_not, bitwise_not), TAPE_UNARY(logistic, sigmoid),
+    TAPE_UNARY(sin, sin), TAPE_UNARY(asin, asin), TAPE_UNARY(sinh, sinh),
+    TAPE_UNARY(asinh, asinh), TAPE_UNARY(cos, cos), TAPE_UNARY(acos, acos),
+    TAPE_UNARY(cosh, cosh), TAPE_UNARY(acosh, acosh), TAPE_UNARY(tan, tan),
+    TAPE_UNARY(atan, atan), TAPE_UNARY(tanh, tanh), TAPE_UNARY(atanh, atanh),
+    TAPE_UNARY(erf, erf), TAPE_UNARY(erfc, erfc), TAPE_UNARY(erf_inv, erfinv)};
+
+std::map<const std::string, std::function<torch::Tensor(const torch::Tensor &, const torch::Tensor &)>> tape_binary = {
+    TAPE_BINARY(add, add), TAPE_BINARY(subtract, subtract), TAPE_BINARY(multiply, multiply),
+    TAPE_BINARY(divide, divide), TAPE_BINARY(remainder, remainder), TAPE_BINARY(power, pow),
+    TAPE_BINARY(atan2, atan2), TAPE_BINARY(min, min), TAPE_BINARY(max, max),
+    TAPE_BINARY(bitwise_and, bitwise_and), TAPE_BINARY(bitwise_or, bitwise_or),
+    TAPE_BINARY(bitwise_xor, bitwise_xor), TAPE_BINARY(left_shift, __lshift__),
+    TAPE_BINARY(right_shift, __rshift__), TAPE_BINARY(equal, eq),
+    TAPE_BINARY(not_equal, not_equal), TAPE_BINARY(greater, greater), TAPE_BINARY(less, less),
+    TAPE_BINARY(greater_equal, greater_equal), TAPE_BINARY(less_equal, less_equal),
+    TAPE_BINARY(logical_and, logical_and), TAPE_BINARY(logical_or, logical_or),
+    TAPE_BINARY(logical_xor, logical_xor), TAPE_BINARY(matmul, matmul),
+    {"quotient", [](const torch::Tensor &a, const torch::Tensor &b) { return torch::divide(a, b, "trunc"); }}};
+
+#define TAPE_RESULT(T) \
+  result = T;          \
+  return nx::nif::ok(env);
+
+// The remaining arguments of the operation are given as argv, so
+// they are read with the same macros as the NIF of the same name.
+ERL_NIF_TERM tape_op(ErlNifEnv *env, const std::string &op, const std::vector<torch::Tensor> &t,
+                     int argc, const ERL_NIF_TERM argv[], torch::Tensor &result)
+{
+  if (t.size() == 1 && argc == 0)
+  {
+    auto unary = tape_unary.find(op);
+    if (unary != tape_unary.end())
+    {
+      TAPE_RESULT(unary->second(t[0]));
+    }
+  }
+
+  if (t.size() == 2 && argc == 0)
+  {
+    auto binary = tape_binary.find(op);
+    if (binary != tape_binary.end())
+    {
+      TAPE_RESULT(binary->second(t[0], t[1]));
+    }
+  }
+
+  if (t.size() == 1)
+  {
+    if (op == "reshape" && argc == 1)
+    {
+      SHAPE_PARAM(0, shape);
+      TAPE_RESULT(torch::reshape(t[0], shape));
+    }
+    if (op == "to_type" && argc == 1)
+    {
+      TYPE_PARAM(0, type);
+      TAPE_RESULT(t[0].toType(type));
+    }
+    if (op == "squeeze" && argc == 0)
+    {
+      TAPE_RESULT(torch::squeeze(t[0]));
+    }
+    if (op == "squeeze" && argc == 1)
+    {
+      PARAM(0, int64_t, dim);
+      TAPE_RESULT(torch::squeeze(t[0], dim));
+    }
+    if (op == "broadcast_to" && argc == 1)
+    {
+      SHAPE_PARAM(0, shape);
+      TAPE_RESULT(torch::broadcast_to(t[0], shape));
+    }
+    if (op == "transpose" && argc == 2)
+    {
+      PARAM(0, int64_t, dim0);
+      PARAM(1, int64_t, dim1);
+      TAPE_RESULT(torch::transpose(t[0], dim0, dim1));
+    }
+    if (op == "permute" && argc == 1)
+    {
+      LIST_PARAM(0, std::vector<int64_t>, dims);
+      TAPE_RESULT(t[0].permute(dims));
+    }
+    if (op == "sum" && argc == 2)
+    {
+      LIST_PARAM(0, std::vector<int64_t>, dims);
+      PARAM(1, bool, keep_dim);
+      TAPE_RESULT(torch::sum(t[0], dims, keep_dim));
+    }
+  }
+
+  if (t.size() == 2)
+  {
+    if (op == "tensordot" && argc == 2)
+    {
+      LIST_PARAM(0, std::vector<int64_t>, axes1);
+      LIST_PARAM(1, std::vector<int64_t>, axes2);
+      TAPE_RESULT(torch::tensordot(t[0], t[1], axes1, axes2));
+    }
+    if (op == "gather" && argc == 1)
+    {
+      PARAM(0, int64_t, axis);
+      TAPE_RESULT(torch::gather(t[0], axis, t[1]));
+    }
+  }
+
+  std::ostringstream msg;
+  msg << "Unsupported tape operation " << op << " with " << t.size() << " tensors and " << argc << " arguments";
+  return nx::nif::error(env, msg.str().c_str());
+}
+
+NIF(run_tape)
+{
+  LIST_PARAM(0, std::vector<torch::Tensor>, tensors);
+  LIST_PARAM(2, std::vector<int64_t>, outputs);
+
+  ERL_NIF_TERM ops = argv[1];
+  ERL_NIF_TERM op_term;
+
+  while (enif_get_list_cell(env, ops, &op_term, &ops))
+  {
+    const ERL_NIF_TERM *op;
+    int arity;
+    std::string name;
+    std::vector<int64_t> indexes;
+
+    if (!enif_get_tuple(env, op_term, &arity, &op) || arity != 3 ||
+        !nx::nif::get_atom(env, op[0], name) || !nx::nif::get_list(env, op[1], indexes))
+      return nx::nif::error(env, "Unable to get tape operation.");
+
+    std::vector<torch::Tensor> operands;
+    for (int64_t index : indexes)
+    {
+      if (index < 0 || index >= (int64_t)tensors.size())
+        return nx::nif::error(env, "Tape operand refers to a tensor not computed yet.");
+      operands.push_back(tensors[index]);
+    }
+
+    std::vector<ERL_NIF_TERM> args;
+    ERL_NIF_TERM head, tail = op[2];
+    while (enif_get_list_cell(env, tail, &head, &tail))
+      args.push_back(head);
+
+    torch::Tensor result;
+
+    try
+    {
+      ERL_NIF_TERM status = tape_op(env, name, operands, args.size(), args.data(), result);
+      if (!enif_is_identical(status, nx::nif::ok(env)))
+        return status;
+    }
+    CATCH()
+
+    tensors.push_back(result);
+  }
+
+  std::vector<ERL_NIF_TERM> res_list;
+
+  try
+  {
+    for (int64_t index : outputs)
+    {
+      if (index < 0 || index >= (int64_t)tensors.size())
+        return nx::nif::error(env, "Tape output refers to a tensor not computed.");
+      res_list.push_back(create_tensor_resource(env, tensors[index].contiguous()));
+    }
+  }
+  CATCH()
+
+  return nx::nif::ok(env, enif_make_list_from_array(env, res_list.data(), res_list.size()));
+}
+
+/* Threads */
+
+// libtorch sizes its intra-op pool to all cores, regardless of how many
+// dirty schedulers run operations at once, which oversubscribes the CPU.
+// Instead, every dirty call sets the intra-op threads to either the hint
+// of the calling process or the configured number of threads. When
+// splitting, the configured threads are divided by the number of calls
+// running at the same time.
+//
+// OpenMP keeps the number of threads per calling thread, but libtorch
+// also sets global state, such as the MKL threads, so we only skip
+// setting it when both the scheduler thread and the last call applied
+// the same number.
+
+int default_threads = 1;
+std::atomic<int> num_threads(0);
+std::atomic<bool> split_threads(false);
+std::atomic<int> running_calls(0);
+std::atomic<int> last_applied_threads(0);
+
+thread_local int applied_threads = 0;
+
+// Hints are kept per process and dropped once the process exits,
+// through monitors held by a single resource.
+void *hints_monitor = NULL;
+
+struct PidHash
+{
+  size_t operator()(const ErlNifPid &pid) const
+  {
+    return enif_hash(ERL_NIF_INTERNAL_HASH, enif_make_pid(NULL, &pid), 0);
+  }
+};
+
+struct PidEqual
+{
+  bool operator()(const ErlNifPid &a, const ErlNifPid &b) const
+  {
+    return enif_compare_pids(&a, &b) == 0;
+  }
+};
+
+struct ThreadHint
+{
+  int threads;
+  ErlNifMonitor monitor;
+};
+
+std::atomic<int> hint_count(0);
+std::mutex hints_mutex;
+std::unordered_map<ErlNifPid, ThreadHint, PidHash, PidEqual> hints;
+
+void hint_down(ErlNifEnv *env, void *obj, ErlNifPid *pid, ErlNifMonitor *mon)
+{
+  std::lock_guard<std::mutex> lock(hints_mutex);
+
+  if (hints.erase(*pid) > 0)
+    hint_count.fetch_sub(1);
+}
+
+int thread_hint(ErlNifEnv *env)
+{
+  ErlNifPid self;
+
+  if (hint_count.load() == 0 || !enif_self(env, &self))
+    return 0;
+
+  std::lock_guard<std::mutex> lock(hints_mutex);
+  auto it = hints.find(self);
+  return it == hints.end() ? 0 : it->second.threads;
+}
+
+struct RunningCall
+{
+  int running;
+  RunningCall() { running = running_calls.fetch_add(1) + 1; }
+  ~RunningCall() { running_calls.fetch_sub(1); }
+};
+
+template <ERL_NIF_TERM (*NAME)(ErlNifEnv *, int, const ERL_NIF_TERM[])>
+ERL_NIF_TERM with_threads(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  RunningCall call;
+  int threads = thread_hint(env);
+
+  if (threads == 0)
+  {
+    threads = num_threads.load();
+    if (threads == 0)
+      threads = default_threads;
+    if (split_threads.load())
+      threads = std::max(1, threads / call.running);
+  }
+
+  if (threads != applied_threads || threads != last_applied_threads.load())
+  {
+    try
+    {
+      at::set_num_threads(threads);
+    }
+    catch (const c10::Error &)
+    {
+      // Some parallel backends do not allow changing the number of
+      // threads once they started, in which case we keep the current
+    }
+
+    applied_threads = threads;
+    last_applied_threads.store(threads);
+  }
+
+  return NAME(env, argc, argv);
+}
+
+NIF(set_num_threads)
+{
+  PARAM(0, int, threads);
+  PARAM(1, bool, split);
+
+  if (threads < 0)
+    return nx::nif::error(env, "Number of threads must be a non-negative integer");
+
+  num_threads.store(threads);
+  split_threads.store(split);
+  return nx::nif::ok(env);
+}
+
+// Runs through with_threads, so it returns the number of threads
+// applied to operations called by the calling process
+NIF(get_num_threads)
+{
+  return nx::nif::ok(env, nx::nif::make(env, (int)at::get_num_threads()));
+}
+
+NIF(set_num_interop_threads)
+{
+  PARAM(0, int, threads);
+
+  try
+  {
+    at::set_num_interop_threads(threads);
+  }
+  CATCH()
+
+  return nx::nif::ok(env);
+}
+
+NIF(get_num_interop_threads)
+{
+  return nx::nif::ok(env, nx::nif::make(env, (int)at::get_num_interop_threads()));
+}
+
+NIF(set_thread_hint)
+{
+  PARAM(0, int, threads);
+  ErlNifPid self;
+
+  if (!enif_self(env, &self))
+    return nx::nif::error(env, "Unable to get the calling process");
+
+  std::lock_guard<std::mutex> lock(hints_mutex);
+  auto it = hints.find(self);
+
+  if (threads <= 0)
+  {
+    if (it != hints.end())
+    {
+      enif_demonitor_process(env, hints_monitor, &it->second.monitor);
+      hints.erase(it);
+      hint_count.fetch_sub(1);
+    }
+  }
+  else if (it != hints.end())
+  {
+    it->second.threads = threads;
+  }
+  else
+  {
+    ThreadHint hint;
+    hint.threads = threads;
+
+    if (enif_monitor_process(env, hints_monitor, &self, &hint.monitor) != 0)
+      return nx::nif::error(env, "Unable to monitor the calling process");
+
+    hints.emplace(self, hint);
+    hint_count.fetch_add(1);
+  }
+
+  return nx::nif::ok(env);
+}
+
 int load(ErlNifEnv *env, void **priv_data, ERL_NIF_TERM load_info)
 {
   if (open_resource_type(env) == -1)
     return -1;
 
+  // The monitor resource is never released, as hints live as long as the library
+  hints_monitor = enif_alloc_resource(HINTS_TYPE, 1);
+  default_threads = at::get_num_threads();
+
   // Silence "unused var" warnings.
   (void)(priv_data);
   (void)(load_info);
@@ -790,9 +1369,9 @@ int load(ErlNifEnv *env, void **priv_data, ERL_NIF_TERM load_info)
 #define F(NAME, ARITY)    \
   {#NAME, ARITY, NAME, 0}
 
-#define DF(NAME, ARITY)                                      \
-  {#NAME "_cpu", ARITY, NAME, ERL_NIF_DIRTY_JOB_CPU_BOUND},  \
-  {#NAME "_io", ARITY, NAME, ERL_NIF_DIRTY_JOB_IO_BOUND}
+#define DF(NAME, ARITY)                                                    \
+  {#NAME "_cpu", ARITY, with_threads<NAME>, ERL_NIF_DIRTY_JOB_CPU_BOUND},  \
+  {#NAME "_io", ARITY, with_threads<NAME>, ERL_NIF_DIRTY_JOB_IO_BOUND}
 
 static ErlNifFunc nif_functions[] = {
     DF(randint, 5),
@@ -894,6 +1473,46 @@ static ErlNifFunc nif_functions[] = {
     DF(erfc, 1),
     DF(erf_inv, 1),
 
+    DF(add_out, 3),
+    DF(subtract_out, 3),
+    DF(multiply_out, 3),
+    DF(divide_out, 3),
+    DF(remainder_out, 3),
+    DF(power_out, 3),
+    DF(atan2_out, 3),
+    DF(min_out, 3),
+    DF(max_out, 3),
+
+    DF(abs_out, 2),
+    DF(ceil_out, 2),
+    DF(floor_out, 2),
+    DF(negate_out, 2),
+    DF(round_out, 2),
+    DF(sign_out, 2),
+    DF(exp_out, 2),
+    DF(expm1_out, 2),
+    DF(sqrt_out, 2),
+    DF(rsqrt_out, 2),
+    DF(log_out, 2),
+    DF(log1p_out, 2),
+    DF(bitwise_not_out, 2),
+    DF(logistic_out, 2),
+    DF(sin_out, 2),
+    DF(asin_out, 2),
+    DF(sinh_out, 2),
+    DF(asinh_out, 2),
+    DF(cos_out, 2),
+    DF(acos_out, 2),
+    DF(cosh_out, 2),
+    DF(acosh_out, 2),
+    DF(tan_out, 2),
+    DF(atan_out, 2),
+    DF(tanh_out, 2),
+    DF(atanh_out, 2),
+    DF(erf_out, 2),
+    DF(erfc_out, 2),
+    DF(erf_inv_out, 2),
+
     DF(tensordot, 4),
     DF(matmul, 2),
 
@@ -909,6 +1528,16 @@ static ErlNifFunc nif_functions[] = {
     DF(sort, 3),
     DF(clip, 3),
 
+    DF(jit_run, 2),
+    DF(run_tape, 3),
+    {"jit_compile", 1, jit_compile, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+
+    F(set_num_threads, 2),
+    {"get_num_threads", 0, with_threads<get_num_threads>, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    F(set_thread_hint, 1),
+    F(get_num_interop_threads, 0),
+    {"set_num_interop_threads", 1, set_num_interop_threads, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+
     F(cuda_is_available, 0),
     F(cuda_device_count, 0),
     F(scalar_type, 1),
@@ -131,6 +131,72 @@ defmodule Torchx do
   def device_count(:cuda), do: NIF.cuda_device_count()
   def device_count(_), do: raise("Only CUDA devices can be counted for now.")
 
+  @doc """
+  Sets the number of threads each operation uses on the CPU.
+
+  libtorch parallelizes every operation over all cores by default.
+  As operations called by different processes run at the same time
+  on dirty schedulers, this may start several times more threads
+  than there are cores, which slows everything down.
+
+  It may also be set on startup with the `:num_threads` and
+  `:split_threads` application environment keys of `:torchx`.
+
+  ## Options
+
+    * `:split` - when `true`, `threads` are divided by the number of
+      operations running at the same time, so concurrent callers
+      share the cores. Defaults to `false`
+
+  """
+  def set_num_threads(threads, opts \\ []) when is_integer(threads) and threads > 0 do
+    NIF.set_num_threads(threads, Keyword.get(opts, :split, false)) |> unwrap!()
+  end
+
+  @doc """
+  Returns the number of threads each operation called by the
+  current process uses on the CPU.
+  """
+  def num_threads(), do: NIF.get_num_threads() |> unwrap!()
+
+  @doc """
+  Sets the number of threads used to run independent operations in
+  parallel, such as in TorchScript graphs.
+
+  It can only be set once, before any such operation runs, so it is
+  best given as `:num_interop_threads` in the application environment
+  of `:torchx`.
+  """
+  def set_num_interop_threads(threads) when is_integer(threads) and threads > 0 do
+    NIF.set_num_interop_threads(threads) |> unwrap!()
+  end
+
+  @doc """
+  Returns the number of threads used to run independent operations in parallel.
+  """
+  def num_interop_threads(), do: NIF.get_num_interop_threads() |> unwrap!()
+
+  @doc """
+  Runs `fun` with operations called by the current process using
+  up to `threads` threads each, regardless of `set_num_threads/2`.
+
+  Use it to give latency sensitive callers more threads, or batch
+  jobs fewer, than the configured default.
+  """
+  def with_num_threads(threads, fun)
+      when is_integer(threads) and threads > 0 and is_function(fun, 0) do
+    previous = Process.get(:torchx_num_threads, 0)
+    NIF.set_thread_hint(threads) |> unwrap!()
+    Process.put(:torchx_num_threads, threads)
+
+    try do
+      fun.()
+    after
+      NIF.set_thread_hint(previous) |> unwrap!()
+      Process.put(:torchx_num_threads, previous)
+    end
+  end
+
   # LibTorch API bindings
 
   ## Creation / conversion
@@ -244,6 +310,52 @@ defmodule Torchx do
   deftensor round(tensor)
   deftensor sign(tensor)
 
+  ## Out ops
+
+  # They write into tensor_out, which may be one of the operands for
+  # in-place operations. tensor_out must not be referenced anywhere
+  # else nor come from from_blob, which aliases immutable binaries.
+
+  deftensor add_out(tensor_out, tensorA, tensorB)
+  deftensor subtract_out(tensor_out, tensorA, tensorB)
+  deftensor multiply_out(tensor_out, tensorA, tensorB)
+  deftensor divide_out(tensor_out, tensorA, tensorB)
+  deftensor remainder_out(tensor_out, tensorA, tensorB)
+  deftensor power_out(tensor_out, tensorA, tensorB)
+  deftensor atan2_out(tensor_out, tensorA, tensorB)
+  deftensor min_out(tensor_out, tensorA, tensorB)
+  deftensor max_out(tensor_out, tensorA, tensorB)
+
+  deftensor exp_out(tensor_out, tensor)
+  deftensor expm1_out(tensor_out, tensor)
+  deftensor log_out(tensor_out, tensor)
+  deftensor log1p_out(tensor_out, tensor)
+  deftensor logistic_out(tensor_out, tensor)
+  deftensor cos_out(tensor_out, tensor)
+  deftensor sin_out(tensor_out, tensor)
+  deftensor tan_out(tensor_out, tensor)
+  deftensor cosh_out(tensor_out, tensor)
+  deftensor sinh_out(tensor_out, tensor)
+  deftensor tanh_out(tensor_out, tensor)
+  deftensor acos_out(tensor_out, tensor)
+  deftensor asin_out(tensor_out, tensor)
+  deftensor atan_out(tensor_out, tensor)
+  deftensor acosh_out(tensor_out, tensor)
+  deftensor asinh_out(tensor_out, tensor)
+  deftensor atanh_out(tensor_out, tensor)
+  deftensor sqrt_out(tensor_out, tensor)
+  deftensor rsqrt_out(tensor_out, tensor)
+  deftensor erf_out(tensor_out, tensor)
+  deftensor erfc_out(tensor_out, tensor)
+  deftensor erf_inv_out(tensor_out, tensor)
+  deftensor abs_out(tensor_out, tensor)
+  deftensor bitwise_not_out(tensor_out, tensor)
+  deftensor ceil_out(tensor_out, tensor)
+  deftensor floor_out(tensor_out, tensor)
+  deftensor negate_out(tensor_out, tensor)
+  deftensor round_out(tensor_out, tensor)
+  deftensor sign_out(tensor_out, tensor)
+
   ## LinAlg
 
   deftensor cholesky(tensor)
@@ -258,6 +370,34 @@ defmodule Torchx do
   deftensor sort(tensor, axis, descending)
   deftensor clip(tensor, tensor_min, tensor_max)
 
+  ## TorchScript
+
+  deftensor jit_run(graph, tensors)
+
+  ## Tape
+
+  @doc """
+  Runs a list of operations in a single call.
+
+  Small operations spend most of their time going in and out of the
+  NIF rather than computing. A tape runs many of them at once, keeping
+  intermediate results in C++ and returning only the given `outputs`.
+
+  Each operation is a `{name, operands, args}` tuple, where `name` is
+  the Torchx function, `operands` are the indexes of its tensors and
+  `args` are its remaining arguments. Indexes refer to `tensors`
+  followed by the results of the previous operations:
+
+      [a, b] = tensors
+      ops = [{:add, [0, 1], []}, {:sum, [2], [[0], false]}]
+      [sum] = Torchx.run_tape([a, b], ops, [3])
+
+  Element-wise operations, `reshape`, `to_type`, `squeeze`,
+  `broadcast_to`, `transpose`, `permute`, `sum`, `tensordot`,
+  `matmul` and `gather` are supported.
+  """
+  deftensor run_tape(tensors, ops, outputs)
+
   ## Dirty non-tensor return values
 
   defvalue to_blob(tensor)
@@ -271,6 +411,11 @@ defmodule Torchx do
   def shape({dev, ref}) when is_tensor(dev, ref), do: NIF.shape(ref) |> unwrap!()
   def nbytes({dev, ref}) when is_tensor(dev, ref), do: NIF.nbytes(ref) |> unwrap!()
 
+  @doc """
+  Parses the given TorchScript IR into a graph, which is run with `jit_run/2`.
+  """
+  def jit_compile(ir) when is_binary(ir), do: NIF.jit_compile(ir) |> unwrap!()
+
   ## Nx
 
   @doc """
@@ -324,6 +469,7 @@ defmodule Torchx do
     {id, index}
   end
 
+  defp unwrap!(:ok), do: :ok
   defp unwrap!({:ok, result}), do: result
   defp unwrap!({:error, error}), do: raise("Torchx: " <> List.to_string(error))
 
@@ -0,0 +1,24 @@
+defmodule Torchx.Application do
+  @moduledoc false
+  use Application
+
+  def start(_type, _args) do
+    # The graphs compiled by Torchx.Defn
+    :ets.new(Torchx.Defn, [:public, :set, :named_table, read_concurrency: true])
+    configure_threads(Application.get_all_env(:torchx))
+    Supervisor.start_link([], name: __MODULE__, strategy: :one_for_one)
+  end
+
+  defp configure_threads(config) do
+    threads = config[:num_threads]
+    split = Keyword.get(config, :split_threads, false)
+
+    if threads || split do
+      Torchx.set_num_threads(threads || Torchx.num_threads(), split: split)
+    end
+
+    if threads = config[:num_interop_threads] do
+      Torchx.set_num_interop_threads(threads)
+    end
+  end
+end
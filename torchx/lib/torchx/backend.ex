@@ -368,18 +368,17 @@ defmodule Torchx.Backend do
     lin_idx_num_elements =
       idx.shape |> Tuple.delete_at(tuple_size(idx.shape) - 1) |> Tuple.product()
 
-    linear_indices =
-      idx
-      |> from_nx()
-      |> Torchx.tensordot(linear_indices_offsets, [tuple_size(idx.shape) - 1], [0])
-      |> Torchx.reshape({lin_idx_num_elements})
-
-    tensor
-    |> from_nx()
-    |> Torchx.reshape({Tuple.product(tensor.shape)})
-    |> Torchx.gather(linear_indices, 0)
-    |> Torchx.reshape(out.shape)
-    |> to_nx(out)
+    # The indices are computed and gathered in a single call
+    ops = [
+      {:tensordot, [0, 1], [[tuple_size(idx.shape) - 1], [0]]},
+      {:reshape, [3], [{lin_idx_num_elements}]},
+      {:reshape, [2], [{Tuple.product(tensor.shape)}]},
+      {:gather, [5, 4], [0]},
+      {:reshape, [6], [out.shape]}
+    ]
+
+    [result] = Torchx.run_tape([from_nx(idx), linear_indices_offsets, from_nx(tensor)], ops, [7])
+    to_nx(result, out)
   end
 
   defp linear_indices_offsets(shape) do
@@ -564,7 +563,9 @@ defmodule Torchx.Backend do
       [:equal, :not_equal, :greater, :less, :greater_equal, :less_equal] ++
       [:logical_and, :logical_or, :logical_xor]
 
-  for op <- binary_ops do
+  out_ops = [:add, :subtract, :multiply, :divide, :remainder, :power, :atan2, :min, :max]
+
+  for op <- binary_ops -- out_ops do
     @impl true
     def unquote(op)(out, l, r) do
       {left, right} = maybe_cast_u8(l, r)
@@ -574,6 +575,35 @@ defmodule Torchx.Backend do
     end
   end
 
+  for op <- out_ops do
+    @impl true
+    def unquote(op)(out, l, r) do
+      {left, right} = maybe_cast_u8(l, r)
+      left_tx = from_nx(left)
+      right_tx = from_nx(right)
+
+      # Operands cast by maybe_cast_u8 are not referenced anywhere
+      # else, so the result is written into them when it fits
+      cond do
+        cast_into?(out, l, left) -> Torchx.unquote(:"#{op}_out")(left_tx, left_tx, right_tx)
+        cast_into?(out, r, right) -> Torchx.unquote(:"#{op}_out")(right_tx, left_tx, right_tx)
+        true -> Torchx.unquote(op)(left_tx, right_tx)
+      end
+      |> to_nx(out)
+    end
+  end
+
+  # Only Torchx tensors are cast by copying, others may be
+  # transferred from binaries which must not be written to
+  defp cast_into?(
+         %T{type: type, shape: shape},
+         %T{data: %TB{ref: original_ref}},
+         %T{type: type, shape: shape, data: %TB{ref: cast_ref}}
+       ),
+       do: original_ref != cast_ref
+
+  defp cast_into?(_out, _original, _cast), do: false
+
   defp maybe_cast_u8(%T{type: {t, _}} = left, %T{type: {t, _}} = right),
     do: {left, right}
 
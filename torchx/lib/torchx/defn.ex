@@ -0,0 +1,466 @@
+defmodule Torchx.Defn do
+  @moduledoc """
+  A `Nx.Defn` compiler that runs numerical definitions as TorchScript graphs.
+
+  Under `Nx.Defn.Evaluator`, every operation inside `defn` is a separate
+  call into libtorch which allocates its own tensor. `Torchx.Defn` lowers
+  the whole expression into a single TorchScript graph instead, which is
+  optimized by the TorchScript executor and run with a single NIF call:
+
+      Nx.Defn.jit(&MyModule.softmax/1, [tensor], compiler: Torchx.Defn)
+
+  Graphs are compiled once per definition, argument types, shapes and
+  names, and options. Constants and tensors built inside the definition
+  are created once, when the graph is compiled.
+
+  Element-wise operations on intermediate results which are not used
+  afterwards are done in-place, so chains of them reuse one buffer
+  instead of allocating a tensor per operation. Arguments are never
+  written to.
+
+  Element-wise operations, `reshape`, `squeeze`, `transpose`, `broadcast`,
+  `as_type`, `select`, `dot` (without batch axes) and `sum` are lowered to
+  the graph. Definitions with any other operation, such as `while` or
+  hooks, fall back to `Nx.Defn.Evaluator`, which runs them operation by
+  operation.
+  """
+
+  @behaviour Nx.Defn.Compiler
+
+  alias Nx.Defn.{Composite, Expr}
+  alias Nx.Tensor, as: T
+
+  @impl true
+  def __stream__(key, input, acc, vars, fun, opts) do
+    count = Composite.count(input) + Composite.count(acc)
+    vars = Enum.drop(vars, count)
+
+    Nx.Defn.Stream.start_link(input, acc, fn input, acc ->
+      vars = Composite.from_runtime_args([input, acc], vars)
+      __jit__(key, vars, fun, opts)
+    end)
+  end
+
+  @impl true
+  def __jit__(key, vars, fun, opts) do
+    args_key = Enum.map(vars, &{&1.type, &1.shape, &1.names})
+    cache_key = {key, args_key, Keyword.delete(opts, :hooks)}
+
+    case compile(cache_key, vars, fun) do
+      {:graph, graph, sources, output} ->
+        run(graph, sources, output, List.to_tuple(vars))
+
+      :evaluator ->
+        Nx.Defn.Evaluator.__jit__(key, vars, fun, opts)
+    end
+  end
+
+  defp compile(cache_key, vars, fun) do
+    case :ets.lookup(__MODULE__, cache_key) do
+      [{_, entry}] ->
+        entry
+
+      [] ->
+        expr = fun.(vars)
+
+        entry =
+          case lower(expr) do
+            {:ok, ir, sources} ->
+              {:graph, Torchx.jit_compile(ir), sources, Nx.to_template(expr)}
+
+            :unsupported ->
+              :evaluator
+          end
+
+        :ets.insert(__MODULE__, {cache_key, entry})
+        entry
+    end
+  end
+
+  defp run(_graph, [], output, _vars) do
+    output
+  end
+
+  defp run(graph, sources, output, vars) do
+    tensors =
+      Enum.map(sources, fn
+        i when is_integer(i) -> Torchx.from_nx(elem(vars, i))
+        tensor -> tensor
+      end)
+
+    {result, []} =
+      Composite.traverse(output, Torchx.jit_run(graph, tensors), fn t, [out | outs] ->
+        {Torchx.Backend.to_nx(out, t), outs}
+      end)
+
+    result
+  end
+
+  ## Lowering
+
+  # Expressions are lowered to TorchScript IR text. Every value in the
+  # graph has the torch type matching the Nx type of its expression,
+  # so operations cast their operands whenever Nx semantics require.
+  # The graph inputs are the tensors captured at compile time and the
+  # used parameters, in the order they are found, which are given as
+  # sources: captured tensors or parameter positions.
+
+  @unary_ops [
+    exp: "exp",
+    expm1: "expm1",
+    log: "log",
+    log1p: "log1p",
+    logistic: "sigmoid",
+    cos: "cos",
+    sin: "sin",
+    tan: "tan",
+    cosh: "cosh",
+    sinh: "sinh",
+    tanh: "tanh",
+    acos: "acos",
+    asin: "asin",
+    atan: "atan",
+    acosh: "acosh",
+    asinh: "asinh",
+    atanh: "atanh",
+    sqrt: "sqrt",
+    rsqrt: "rsqrt",
+    erf: "erf",
+    erfc: "erfc",
+    erf_inv: "erfinv",
+    abs: "abs",
+    bitwise_not: "bitwise_not",
+    ceil: "ceil",
+    floor: "floor",
+    negate: "neg",
+    round: "round",
+    sign: "sign"
+  ]
+
+  @binary_ops [
+    multiply: "mul",
+    divide: "div",
+    power: "pow",
+    remainder: "remainder",
+    atan2: "atan2",
+    min: "minimum",
+    max: "maximum",
+    bitwise_and: "bitwise_and",
+    bitwise_or: "bitwise_or",
+    bitwise_xor: "bitwise_xor",
+    left_shift: "__lshift__",
+    right_shift: "__rshift__"
+  ]
+
+  @comparison_ops [
+    equal: "eq",
+    not_equal: "ne",
+    greater: "gt",
+    less: "lt",
+    greater_equal: "ge",
+    less_equal: "le"
+  ]
+
+  @logical_ops [logical_and: "logical_and", logical_or: "logical_or", logical_xor: "logical_xor"]
+
+  @unary_names Keyword.keys(@unary_ops)
+  @binary_names Keyword.keys(@binary_ops)
+  @comparison_names Keyword.keys(@comparison_ops)
+  @logical_names Keyword.keys(@logical_ops)
+
+  @captured_ops [:tensor, :iota, :eye]
+
+  # The c10::ScalarType values
+  @dtypes %{
+    {:u, 8} => 0,
+    {:s, 8} => 1,
+    {:s, 16} => 2,
+    {:s, 32} => 3,
+    {:s, 64} => 4,
+    {:f, 16} => 5,
+    {:f, 32} => 6,
+    {:f, 64} => 7,
+    {:bf, 16} => 15
+  }
+
+  @bool 11
+
+  defp lower(expr) do
+    state = %{nodes: [], count: 0, sources: [], ids: %{}, shapes: %{}}
+
+    {outputs, state} =
+      Composite.reduce(expr, {[], state}, fn %T{} = t, {outputs, state} ->
+        {name, state} = value(t, state)
+        {[name | outputs], state}
+      end)
+
+    outputs = Enum.reverse(outputs)
+    sources = Enum.reverse(state.sources)
+    inputs = Enum.with_index(sources, fn _, i -> "%i#{i} : Tensor" end)
+
+    lines =
+      for {name, type, kind, inputs} <- in_place(Enum.reverse(state.nodes), outputs, state.shapes) do
+        ["  ", name, " : ", type, " = ", kind, "(", Enum.join(inputs, ", "), ")\n"]
+      end
+
+    ir =
+      IO.iodata_to_binary([
+        "graph(",
+        Enum.join(inputs, ", "),
+        "):\n",
+        lines,
+        "  return (",
+        Enum.join(outputs, ", "),
+        ")\n"
+      ])
+
+    {:ok, ir, sources}
+  catch
+    :unsupported -> :unsupported
+  end
+
+  defp value(%T{data: %Expr{id: id}} = t, state) do
+    case state.ids do
+      %{^id => name} ->
+        {name, state}
+
+      %{} ->
+        {name, state} = lower_op(t, state)
+        state = put_in(state.ids[id], name)
+        {name, put_in(state.shapes[name], t.shape)}
+    end
+  end
+
+  defp lower_op(%T{data: %Expr{op: :metadata, args: [expr, _meta]}}, state) do
+    value(expr, state)
+  end
+
+  # Tensors coming from comparisons in Torchx.Backend are booleans
+  defp lower_op(%T{data: %Expr{op: :parameter, args: [i]}, type: type}, state) do
+    {name, state} = input(i, state)
+    if type == {:u, 8}, do: cast(name, type, state), else: {name, state}
+  end
+
+  defp lower_op(%T{data: %Expr{op: :constant, args: [number]}, type: type, shape: shape}, state) do
+    dtype!(type)
+    {name, state} = input(Torchx.from_nx(Nx.tensor(number, type: type)), state)
+    expand(name, shape, state)
+  end
+
+  defp lower_op(%T{data: %Expr{op: op}, type: type} = t, state) when op in @captured_ops do
+    dtype!(type)
+    tensor = Nx.Defn.Evaluator.__jit__(nil, [], fn [] -> t end, [])
+    input(Torchx.from_nx(tensor), state)
+  end
+
+  defp lower_op(%T{data: %Expr{op: op, args: [arg]}, type: type}, state)
+       when op in @unary_names do
+    {x, state} = operand(arg, type, state)
+    node("Tensor", "aten::#{Keyword.fetch!(@unary_ops, op)}", [x], state)
+  end
+
+  defp lower_op(%T{data: %Expr{op: op, args: [left, right]}, type: type}, state)
+       when op in [:add, :subtract] do
+    {a, state} = operand(left, type, state)
+    {b, state} = operand(right, type, state)
+    {alpha, state} = constant("int", 1, state)
+    kind = if op == :add, do: "aten::add", else: "aten::sub"
+    node("Tensor", kind, [a, b, alpha], state)
+  end
+
+  defp lower_op(%T{data: %Expr{op: :quotient, args: [left, right]}, type: type}, state) do
+    {a, state} = operand(left, type, state)
+    {b, state} = operand(right, type, state)
+    {mode, state} = constant("str", ~s("trunc"), state)
+    node("Tensor", "aten::div", [a, b, mode], state)
+  end
+
+  defp lower_op(%T{data: %Expr{op: op, args: [left, right]}, type: type}, state)
+       when op in @binary_names do
+    {a, state} = operand(left, type, state)
+    {b, state} = operand(right, type, state)
+    node("Tensor", "aten::#{Keyword.fetch!(@binary_ops, op)}", [a, b], state)
+  end
+
+  defp lower_op(%T{data: %Expr{op: op, args: [left, right]}, type: type}, state)
+       when op in @comparison_names do
+    merged = Nx.Type.merge(left.type, right.type)
+    {a, state} = operand(left, merged, state)
+    {b, state} = operand(right, merged, state)
+    {name, state} = node("Tensor", "aten::#{Keyword.fetch!(@comparison_ops, op)}", [a, b], state)
+    cast(name, type, state)
+  end
+
+  defp lower_op(%T{data: %Expr{op: op, args: [left, right]}, type: type}, state)
+       when op in @logical_names do
+    {a, state} = value(left, state)
+    {b, state} = value(right, state)
+    {name, state} = node("Tensor", "aten::#{Keyword.fetch!(@logical_ops, op)}", [a, b], state)
+    cast(name, type, state)
+  end
+
+  defp lower_op(%T{data: %Expr{op: :select, args: [pred, on_true, on_false]}, type: type}, state) do
+    {pred, state} = value(pred, state)
+    {pred, state} = to(pred, @bool, state)
+    {a, state} = operand(on_true, type, state)
+    {b, state} = operand(on_false, type, state)
+    node("Tensor", "aten::where", [pred, a, b], state)
+  end
+
+  defp lower_op(%T{data: %Expr{op: :as_type, args: [arg]}, type: type}, state) do
+    operand(arg, type, state)
+  end
+
+  defp lower_op(%T{data: %Expr{op: op, args: [arg | _]}, shape: shape}, state)
+       when op in [:reshape, :squeeze] do
+    {x, state} = value(arg, state)
+    reshape(x, shape, state)
+  end
+
+  defp lower_op(%T{data: %Expr{op: :transpose, args: [arg, axes]}}, state) do
+    {x, state} = value(arg, state)
+    {dims, state} = int_list(axes, state)
+    node("Tensor", "aten::permute", [x, dims], state)
+  end
+
+  defp lower_op(%T{data: %Expr{op: :broadcast, args: [arg, shape, axes]}}, state) do
+    {x, state} = value(arg, state)
+
+    # Torch broadcasts trailing axes, so the tensor is first
+    # reshaped to put its axes where Nx maps them
+    inner =
+      for i <- Nx.axes(shape) do
+        if pos = Enum.find_index(axes, &(&1 == i)), do: elem(arg.shape, pos), else: 1
+      end
+      |> List.to_tuple()
+
+    {x, state} = if inner == arg.shape, do: {x, state}, else: reshape(x, inner, state)
+    expand(x, shape, state)
+  end
+
+  defp lower_op(%T{data: %Expr{op: :dot, args: [left, c1, [], right, c2, []]}, type: type}, state) do
+    {a, state} = operand(left, type, state)
+    {b, state} = operand(right, type, state)
+    {dims_a, state} = int_list(c1, state)
+    {dims_b, state} = int_list(c2, state)
+    node("Tensor", "aten::tensordot", [a, b, dims_a, dims_b], state)
+  end
+
+  defp lower_op(%T{data: %Expr{op: :sum, args: [arg, opts]}, type: type}, state) do
+    axes = opts[:axes] || Nx.axes(arg.shape)
+
+    if axes == [] do
+      operand(arg, type, state)
+    else
+      {x, state} = value(arg, state)
+      {dims, state} = int_list(axes, state)
+      {keep, state} = constant("bool", if(opts[:keep_axes], do: 1, else: 0), state)
+      {dtype, state} = constant("int", dtype!(type), state)
+      node("Tensor", "aten::sum", [x, dims, keep, dtype], state)
+    end
+  end
+
+  defp lower_op(_expr, _state) do
+    throw(:unsupported)
+  end
+
+  ## In-place operations
+
+  # Operations allocate a new tensor for their result. When the first
+  # operand of an element-wise operation is an intermediate result of
+  # the same shape which is not used anywhere else afterwards, the
+  # operation is done in-place on it instead. Graph inputs, which may
+  # alias binaries, and tensors with views taken from them are never
+  # written to.
+
+  @in_place Keyword.values(@unary_ops) ++
+              ~w(add sub mul div pow remainder atan2 bitwise_and bitwise_or bitwise_xor)
+
+  @in_place_kinds Map.new(@in_place, &{"aten::#{&1}", "aten::#{&1}_"})
+
+  @views ["aten::to", "aten::reshape", "aten::permute", "aten::expand"]
+
+  defp in_place(nodes, outputs, shapes) do
+    indexed = Enum.with_index(nodes)
+
+    last_uses =
+      for {{_, _, _, inputs}, i} <- indexed, input <- inputs, into: %{}, do: {input, i}
+
+    last_uses = Enum.reduce(outputs, last_uses, &Map.put(&2, &1, :output))
+
+    viewed =
+      for {_, _, kind, inputs} <- nodes, kind in @views, input <- inputs, into: MapSet.new() do
+        input
+      end
+
+    owned =
+      for {name, "Tensor", "aten::" <> _ = kind, _} <- nodes,
+          kind not in @views and not MapSet.member?(viewed, name),
+          into: MapSet.new(),
+          do: name
+
+    Enum.map(indexed, fn {{name, type, kind, inputs} = node, i} ->
+      with %{^kind => in_place_kind} <- @in_place_kinds,
+           [x | _] <- inputs,
+           true <- MapSet.member?(owned, x) and Map.fetch!(last_uses, x) == i,
+           %{^x => shape, ^name => shape} <- shapes do
+        {name, type, in_place_kind, inputs}
+      else
+        _ -> node
+      end
+    end)
+  end
+
+  ## Graph helpers
+
+  defp input(source, state) do
+    name = "%i#{length(state.sources)}"
+    {name, %{state | sources: [source | state.sources]}}
+  end
+
+  defp node(type, kind, inputs, state) do
+    name = "%v#{state.count}"
+    node = {name, type, kind, inputs}
+    {name, %{state | nodes: [node | state.nodes], count: state.count + 1}}
+  end
+
+  defp constant(type, value, state) do
+    node(type, "prim::Constant[value=#{value}]", [], state)
+  end
+
+  defp int_list(ints, state) do
+    {names, state} = Enum.map_reduce(ints, state, &constant("int", &1, &2))
+    node("int[]", "prim::ListConstruct", names, state)
+  end
+
+  defp operand(%T{type: type} = expr, type, state), do: value(expr, state)
+
+  defp operand(expr, type, state) do
+    {name, state} = value(expr, state)
+    cast(name, type, state)
+  end
+
+  defp cast(name, type, state), do: to(name, dtype!(type), state)
+
+  defp to(name, dtype, state) do
+    {dtype, state} = constant("int", dtype, state)
+    {no, state} = constant("bool", 0, state)
+    {none, state} = node("NoneType", "prim::Constant", [], state)
+    node("Tensor", "aten::to", [name, dtype, no, no, none], state)
+  end
+
+  defp reshape(name, shape, state) do
+    {sizes, state} = int_list(Tuple.to_list(shape), state)
+    node("Tensor", "aten::reshape", [name, sizes], state)
+  end
+
+  defp expand(name, {}, state), do: {name, state}
+
+  defp expand(name, shape, state) do
+    {sizes, state} = int_list(Tuple.to_list(shape), state)
+    {implicit, state} = constant("bool", 0, state)
+    node("Tensor", "aten::expand", [name, sizes, implicit], state)
+  end
+
+  defp dtype!(type), do: Map.get(@dtypes, type) || throw(:unsupported)
+end
@@ -15,6 +15,14 @@ defmodule Torchx.NIF do
       do: :erlang.nif_error(:undef)
   end
 
+  def jit_compile(_ir), do: :erlang.nif_error(:undef)
+
+  def set_num_threads(_threads, _split), do: :erlang.nif_error(:undef)
+  def get_num_threads(), do: :erlang.nif_error(:undef)
+  def set_num_interop_threads(_threads), do: :erlang.nif_error(:undef)
+  def get_num_interop_threads(), do: :erlang.nif_error(:undef)
+  def set_thread_hint(_threads), do: :erlang.nif_error(:undef)
+
   def cuda_is_available(), do: :erlang.nif_error(:undef)
   def cuda_device_count(), do: :erlang.nif_error(:undef)
 
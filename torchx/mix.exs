@@ -39,6 +39,7 @@ defmodule Torchx.MixProject do
   # Run "mix help compile.app" to learn about applications.
   def application do
     [
+      mod: {Torchx.Application, []},
       extra_applications: [:logger]
     ]
   end
@@ -51,7 +52,8 @@ defmodule Torchx.MixProject do
     [
       {:nx, path: "../nx"},
       {:elixir_make, "~> 0.6"},
-      {:ex_doc, "~> 0.23", only: :dev}
+      {:ex_doc, "~> 0.23", only: :dev},
+      {:benchee, "~> 1.0", only: :dev}
     ]
   end
 
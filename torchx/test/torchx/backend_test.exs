@@ -183,6 +183,23 @@ defmodule Torchx.BackendTest do
       |> Nx.to_flat_list()
       |> Enum.all?(&(&1 > 7.0 - 3.0 and &1 < 7.0 + 3.0))
     end
+
+    test "from_binary keeps the binary alive and unchanged" do
+      binary = for i <- 0..4095, into: <<>>, do: <<i::float-32-native>>
+      t = Nx.from_binary(binary, {:f, 32}) |> Nx.reshape({64, 64})
+      sum = Nx.add(t, 1.0)
+
+      assert Nx.to_binary(t) == binary
+      assert Nx.to_number(sum[0][1]) == 2.0
+      assert binary == for(i <- 0..4095, into: <<>>, do: <<i::float-32-native>>)
+    end
+
+    test "from_binary with unaligned sub-binaries" do
+      <<_, rest::binary>> = for i <- 0..1024, into: <<>>, do: <<i::signed-64-native>>
+      <<binary::binary-size(8 * 1024), _::binary>> = rest
+      t = Nx.from_binary(binary, {:s, 64})
+      assert Nx.to_binary(t) == binary
+    end
   end
 
   describe "rounding error tests" do
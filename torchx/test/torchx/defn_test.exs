@@ -58,3 +58,82 @@ defmodule Torchx.DefnTest do
     end
   end
 end
+
+defmodule Torchx.DefnCompilerTest do
+  use Torchx.Case, async: true
+
+  import Nx.Defn
+  alias Nx.Tensor, as: T
+  alias Torchx.Backend, as: TB
+
+  defp jit(fun, args), do: Nx.Defn.jit(fun, args, compiler: Torchx.Defn)
+  defp evaluate(fun, args), do: Nx.Defn.jit(fun, args, compiler: Nx.Defn.Evaluator)
+
+  defn softmax(t), do: Nx.exp(t) / Nx.sum(Nx.exp(t), axes: [1], keep_axes: true)
+
+  test "runs element-wise operations and aggregates as a graph" do
+    t = Nx.tensor([[1.0, 2.0, 3.0], [4.0, 5.0, 6.0]])
+    assert %T{data: %TB{}} = result = jit(&softmax/1, [t])
+    assert_all_close(result, evaluate(&softmax/1, [t]))
+  end
+
+  defn affine(x, w, b), do: Nx.dot(x, w) + b
+
+  test "runs dots with broadcasts and integer promotion" do
+    x = Nx.tensor([[1, 2], [3, 4]])
+    w = Nx.tensor([[0.5, 1.0], [1.5, 2.0]])
+    b = Nx.tensor([1.0, -1.0])
+    assert_all_close(jit(&affine/3, [x, w, b]), evaluate(&affine/3, [x, w, b]))
+  end
+
+  defn relu_and_mask(t) do
+    mask = t > 0
+    {Nx.select(mask, t, 0), mask, Nx.transpose(Nx.reshape(t, {3, 2}))}
+  end
+
+  test "runs selects, comparisons and shape operations with many outputs" do
+    t = Nx.tensor([[-1.0, 2.0, -3.0], [4.0, -5.0, 6.0]])
+    {relu, mask, transposed} = jit(&relu_and_mask/1, [t])
+    {expected_relu, expected_mask, expected_transposed} = evaluate(&relu_and_mask/1, [t])
+
+    assert Nx.backend_transfer(relu) == Nx.backend_transfer(expected_relu)
+    assert Nx.backend_transfer(mask) == Nx.backend_transfer(expected_mask)
+    assert Nx.backend_transfer(transposed) == Nx.backend_transfer(expected_transposed)
+  end
+
+  defn add_iota(t), do: t + Nx.iota({2, 2})
+
+  test "captures tensors built inside the definition" do
+    t = Nx.tensor([[1, 1], [1, 1]])
+    assert Nx.backend_transfer(jit(&add_iota/1, [t])) == Nx.tensor([[1, 2], [3, 4]])
+    assert Nx.backend_transfer(jit(&add_iota/1, [t])) == Nx.tensor([[1, 2], [3, 4]])
+  end
+
+  defn chain(x) do
+    a = Nx.exp(x + 1)
+    b = Nx.reshape(a, {3, 2})
+    {Nx.tanh(a * 2 - a), b, x}
+  end
+
+  test "computes intermediates in-place without changing inputs or views" do
+    binary = for i <- 1..6, into: <<>>, do: <<i * 0.1::float-32-native>>
+    t = Nx.from_binary(binary, {:f, 32}) |> Nx.reshape({2, 3})
+    {result, view, input} = jit(&chain/1, [t])
+    {expected, expected_view, _} = evaluate(&chain/1, [t])
+
+    assert_all_close(result, expected)
+    assert_all_close(view, expected_view)
+    assert Nx.to_binary(input) == binary
+    assert Nx.to_binary(t) == binary
+  end
+
+  defn countdown(x) do
+    while x, Nx.greater(x, 0) do
+      x - 1
+    end
+  end
+
+  test "falls back to the evaluator on unsupported operations" do
+    assert Nx.backend_transfer(jit(&countdown/1, [5])) == Nx.tensor(0)
+  end
+end
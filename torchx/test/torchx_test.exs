@@ -21,6 +21,57 @@ defmodule TorchxTest do
     end
   end
 
+  describe "tape" do
+    test "runs operations and returns the given outputs" do
+      a = Torchx.arange(0, 6, 1, :float, :cpu)
+      b = Torchx.arange(6, 12, 1, :float, :cpu)
+
+      ops = [
+        {:add, [0, 1], []},
+        {:reshape, [2], [{2, 3}]},
+        {:sum, [3], [[1], false]},
+        {:to_type, [4], [:long]}
+      ]
+
+      assert [reshaped, sum] = Torchx.run_tape([a, b], ops, [3, 5])
+      assert Torchx.shape(reshaped) == {2, 3}
+      assert Torchx.scalar_type(sum) == :long
+      assert Torchx.to_nx(sum) |> Nx.backend_transfer() == Nx.tensor([24, 42], backend: Nx.BinaryBackend)
+    end
+
+    test "raises on unknown operations" do
+      a = Torchx.arange(0, 6, 1, :float, :cpu)
+
+      assert_raise RuntimeError, ~r"Unsupported tape operation", fn ->
+        Torchx.run_tape([a], [{:unknown, [0], []}], [1])
+      end
+    end
+  end
+
+  describe "threads" do
+    test "with_num_threads" do
+      threads = Torchx.num_threads()
+      a = Torchx.arange(0, 3, 1, :float, :cpu)
+
+      assert {:cpu, ref} = Torchx.with_num_threads(1, fn -> Torchx.tensordot(a, a, [0], [0]) end)
+      assert is_reference(ref)
+      assert Torchx.num_threads() == threads
+    end
+
+    test "with_num_threads applies the hint" do
+      threads = Torchx.num_threads()
+
+      assert Torchx.with_num_threads(1, fn -> Torchx.num_threads() end) == 1
+      assert Torchx.with_num_threads(2, fn -> Torchx.num_threads() end) == 2
+
+      assert Torchx.with_num_threads(1, fn ->
+               Torchx.with_num_threads(2, fn -> Torchx.num_threads() end)
+             end) == 2
+
+      assert Torchx.num_threads() == threads
+    end
+  end
+
   describe "torchx<->nx" do
     test "to_nx" do
       assert Torchx.arange(0, 26, 1, :short, :cpu)